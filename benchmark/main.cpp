@@ -0,0 +1,528 @@
+#include <Crc.h>
+#include <Stream.h>
+#include <TinyLink.h>
+#include <TinyLinkCapture.h>
+#include <TinyLinkDecoder.h>
+#include <TinyLinkEncoder.h>
+#include <TinyLinkGateway.h>
+#include <TinyLinkShardedGateway.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#ifdef TINYLINK_HAS_GATEWAY
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief Stream that appends written bytes to a pre-allocated buffer, which
+ * is rewound after each frame.
+ */
+class MemoryStream : public Stream {
+public:
+    explicit MemoryStream(size_t capacity) : data(capacity), index(0) {}
+
+    size_t write(uint8_t b) override {
+        if (index == data.size()) {
+            index = 0;
+        }
+
+        data[index++] = b;
+        return 1;
+    }
+
+    size_t write(const uint8_t* buffer, size_t size) override {
+        if (index + size > data.size()) {
+            index = 0;
+        }
+
+        memcpy(&data[index], buffer, size);
+        index += size;
+
+        return size;
+    }
+
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    void flush() override {}
+
+    void rewind() { index = 0; }
+
+    std::vector<uint8_t> data;
+    size_t index;
+};
+
+/**
+ * @brief Stream that replays a buffer of encoded frames.
+ */
+class ReplayStream : public Stream {
+public:
+    explicit ReplayStream(const std::vector<uint8_t>& _data) : data(_data), index(0) {}
+
+    size_t write(uint8_t) override { return 1; }
+
+    int available() override { return static_cast<int>(data.size() - index); }
+
+    int read() override {
+        if (index == data.size()) {
+            return -1;
+        }
+
+        return data[index++];
+    }
+
+    int peek() override { return index == data.size() ? -1 : data[index]; }
+    void flush() override {}
+
+    void rewind() { index = 0; }
+
+    const std::vector<uint8_t>& data;
+    size_t index;
+};
+
+/**
+ * @brief The original encoder, which writes every byte to the stream
+ * separately. Kept as a baseline.
+ */
+__attribute__((noinline)) static void writeFrameBytewise(Stream& stream, uint16_t flags, const uint8_t* payload, uint16_t length) {
+    const uint8_t preamble[] = {0x55, 0xAA, 0x55, 0xAA};
+    const uint8_t header[] = {
+        static_cast<uint8_t>(flags >> 0),
+        static_cast<uint8_t>(flags >> 8),
+        static_cast<uint8_t>(length >> 0),
+        static_cast<uint8_t>(length >> 8),
+        static_cast<uint8_t>((flags >> 0) ^ (flags >> 8) ^ (length >> 0) ^ (length >> 8))
+    };
+    const uint32_t crc = CRC32(CRC32(header, sizeof(header)), payload, length);
+    const uint8_t trailer[] = {
+        static_cast<uint8_t>(crc >> 0),
+        static_cast<uint8_t>(crc >> 8),
+        static_cast<uint8_t>(crc >> 16),
+        static_cast<uint8_t>(crc >> 24)
+    };
+
+    const uint8_t* parts[] = {header, payload, trailer};
+    const size_t lengths[] = {sizeof(header), length, sizeof(trailer)};
+
+    stream.write(preamble, sizeof(preamble));
+
+    for (size_t p = 0; p < 3; p++) {
+        for (size_t i = 0; i < lengths[p]; i++) {
+            if (parts[p][i] == FLAG || parts[p][i] == ESCAPE) {
+                stream.write(ESCAPE);
+            }
+
+            stream.write(parts[p][i]);
+        }
+    }
+}
+
+static void countFrame(const frame_t*, void* context) {
+    (*static_cast<size_t*>(context))++;
+}
+
+#ifdef TINYLINK_HAS_GATEWAY
+static void countGatewayFrame(size_t, const frame_t* frame, void* context) {
+    if (frame != NULL) {
+        (*static_cast<size_t*>(context))++;
+    }
+}
+
+/**
+ * @brief Receive frames from a number of socketpair-backed links, and return
+ * the aggregate number of frames per second.
+ */
+static double measureGateway(size_t links, size_t total, const std::vector<uint8_t>& encoded, size_t framesPerBlock) {
+    size_t received = 0;
+    TinyLinkGateway gateway(links, 256, countGatewayFrame, &received);
+
+    std::vector<int> sockets(links);
+    std::vector<int> peers(links);
+    std::vector<size_t> blocks(links, total / links / framesPerBlock);
+    std::vector<size_t> offsets(links, 0);
+
+    for (size_t i = 0; i < links; i++) {
+        int fds[2];
+
+        socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+        fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+
+        gateway.add(fds[0]);
+        sockets[i] = fds[0];
+        peers[i] = fds[1];
+    }
+
+    const size_t expected = links * blocks[0] * framesPerBlock;
+    const auto start = std::chrono::steady_clock::now();
+
+    while (received < expected) {
+        // Every peer writes as much as the socket accepts.
+        for (size_t i = 0; i < links; i++) {
+            while (blocks[i] > 0) {
+                ssize_t written = write(peers[i], &encoded[offsets[i]], encoded.size() - offsets[i]);
+
+                if (written <= 0) {
+                    break;
+                }
+
+                offsets[i] += static_cast<size_t>(written);
+
+                if (offsets[i] == encoded.size()) {
+                    offsets[i] = 0;
+                    blocks[i]--;
+                }
+            }
+        }
+
+        gateway.poll(0);
+    }
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    for (size_t i = 0; i < links; i++) {
+        gateway.remove(i);
+        close(sockets[i]);
+        close(peers[i]);
+    }
+
+    return static_cast<double>(expected) / elapsed.count();
+}
+
+/**
+ * @brief Receive timestamped frames from socketpair-backed links using worker
+ * threads. Print the throughput, and the 99th percentile of the latency from
+ * encoding a frame to reading it from the queue.
+ */
+static void measureShardedGateway(size_t threads, size_t links, size_t total) {
+    TinyLinkShardedGateway gateway(threads, links, 256, 4096);
+
+    std::vector<int> sockets(links);
+    std::vector<int> peers(links);
+
+    for (size_t i = 0; i < links; i++) {
+        int fds[2];
+
+        socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+
+        gateway.add(fds[0]);
+        sockets[i] = fds[0];
+        peers[i] = fds[1];
+    }
+
+    gateway.start();
+
+    // Produce frames in round-robin, in batches of a few frames per link.
+    std::thread producer([&]() {
+        uint8_t encoded[8 * TinyLinkEncoder::maxEncodedLength(32)];
+        uint8_t payload[32] = {0};
+
+        for (size_t sent = 0; sent < total;) {
+            for (size_t i = 0; i < links && sent < total; i++) {
+                size_t length = 0;
+
+                for (size_t j = 0; j < 8 && sent < total; j++, sent++) {
+                    const int64_t now = std::chrono::steady_clock::now().time_since_epoch().count();
+
+                    memcpy(payload, &now, sizeof(now));
+
+                    frame_t frame;
+                    frame.flags = 0x0001;
+                    frame.length = sizeof(payload);
+                    frame.payload = payload;
+
+                    length += TinyLinkEncoder::encode(&frame, &encoded[length], sizeof(encoded) - length);
+                }
+
+                for (size_t offset = 0; offset < length;) {
+                    ssize_t written = write(peers[i], &encoded[offset], length - offset);
+
+                    if (written > 0) {
+                        offset += static_cast<size_t>(written);
+                    }
+                }
+            }
+        }
+    });
+
+    std::vector<int64_t> latencies;
+    latencies.reserve(total);
+
+    const auto start = std::chrono::steady_clock::now();
+
+    while (latencies.size() + gateway.getDrops() < total) {
+        size_t link;
+        frame_t frame;
+
+        if (!gateway.read(&link, &frame)) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        int64_t sent;
+
+        memcpy(&sent, frame.payload, sizeof(sent));
+        latencies.push_back(std::chrono::steady_clock::now().time_since_epoch().count() - sent);
+    }
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    producer.join();
+    gateway.stop();
+
+    for (size_t i = 0; i < links; i++) {
+        close(sockets[i]);
+        close(peers[i]);
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+
+    const double p99 = latencies.empty() ? 0 : latencies[latencies.size() * 99 / 100] / 1e3;
+
+    printf("sharded threads=%zu links=%zu frames=%.0f/s p99=%.1f us drops=%u\n",
+        threads, links, latencies.size() / elapsed.count(), p99, gateway.getDrops());
+}
+#endif
+
+static std::vector<uint8_t> makePayload(size_t length, uint32_t seed) {
+    std::vector<uint8_t> result(length);
+
+    for (size_t i = 0; i < length; i++) {
+        seed = seed * 1103515245 + 12345;
+        result[i] = static_cast<uint8_t>(seed >> 16);
+    }
+
+    return result;
+}
+
+template <typename F>
+static double measure(size_t bytesPerIteration, F&& f) {
+    const size_t iterations = (64 * 1024 * 1024) / bytesPerIteration + 1;
+    const auto start = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < iterations; i++) {
+        f();
+    }
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    return static_cast<double>(iterations * bytesPerIteration) / elapsed.count();
+}
+
+int main() {
+    static uint8_t buffer[4096];
+    const size_t lengths[] = {16, 256, 2048};
+
+    for (size_t length : lengths) {
+        const std::vector<uint8_t> payload = makePayload(length, static_cast<uint32_t>(length));
+
+        MemoryStream stream(2 * length + 64);
+        TinyLink tinylink(stream, buffer, sizeof(buffer));
+
+        const double before = measure(length, [&]() {
+            stream.rewind();
+            writeFrameBytewise(stream, 0x0001, payload.data(), static_cast<uint16_t>(length));
+        });
+
+        const double after = measure(length, [&]() {
+            stream.rewind();
+            tinylink.write(0x0001, payload.data(), static_cast<uint16_t>(length));
+        });
+
+        printf("write length=%zu bytewise=%.1f MB/s batched=%.1f MB/s\n", length, before / 1e6, after / 1e6);
+    }
+
+    for (size_t length : lengths) {
+        const std::vector<uint8_t> payload = makePayload(length, static_cast<uint32_t>(length));
+
+        // Encode the frame once, to decode it many times.
+        MemoryStream encoder(2 * length + 64);
+        TinyLink(encoder, buffer, sizeof(buffer)).write(0x0001, payload.data(), static_cast<uint16_t>(length));
+
+        const std::vector<uint8_t> encoded(encoder.data.begin(), encoder.data.begin() + encoder.index);
+
+        ReplayStream stream(encoded);
+        TinyLink tinylink(stream, buffer, sizeof(buffer));
+        TinyLinkDecoder decoder(buffer, sizeof(buffer));
+        frame_t frame;
+
+        const double before = measure(length, [&]() {
+            stream.rewind();
+
+            while (!tinylink.readFrame(&frame)) {
+            }
+        });
+
+        const double after = measure(length, [&]() {
+            size_t consumed;
+
+            decoder.feed(encoded.data(), encoded.size(), &consumed, &frame);
+        });
+
+        printf("read length=%zu stream=%.1f MB/s decoder=%.1f MB/s\n", length, before / 1e6, after / 1e6);
+    }
+
+    {
+        // Resynchronizing on noise, without any preamble.
+        const std::vector<uint8_t> noise = makePayload(1024 * 1024, 1);
+
+        TinyLinkDecoder decoder(buffer, sizeof(buffer));
+        frame_t frame;
+
+        const double before = measure(noise.size(), [&]() {
+            for (uint8_t byte : noise) {
+                decoder.push(byte, &frame);
+            }
+        });
+
+        const double after = measure(noise.size(), [&]() {
+            size_t consumed;
+
+            decoder.feed(noise.data(), noise.size(), &consumed, &frame);
+        });
+
+        printf("hunt length=%zu push=%.1f MB/s feed=%.1f MB/s\n", noise.size(), before / 1e6, after / 1e6);
+    }
+
+    {
+        // Goodput with bit errors, with and without scanning the bytes of
+        // corrupted frames again.
+        const size_t count = 10000;
+        const size_t length = 32;
+
+        MemoryStream encoder(count * (2 * length + 64));
+        TinyLink tinylink(encoder, buffer, sizeof(buffer));
+
+        for (size_t i = 0; i < count; i++) {
+            const std::vector<uint8_t> payload = makePayload(length, static_cast<uint32_t>(i));
+
+            tinylink.write(0x0001, payload.data(), static_cast<uint16_t>(length));
+        }
+
+        const std::vector<uint8_t> encoded(encoder.data.begin(), encoder.data.begin() + encoder.index);
+        const double rates[] = {0, 1e-5, 1e-4, 1e-3};
+
+        for (size_t drop = 0; drop < 2; drop++) {
+            for (double rate : rates) {
+                // Flip bits, or drop bytes at the given rate per bit.
+                std::vector<uint8_t> corrupted;
+                uint32_t seed = 1;
+
+                for (size_t i = 0; i < encoded.size(); i++) {
+                    uint8_t byte = encoded[i];
+                    bool dropped = false;
+
+                    for (size_t bit = 0; bit < 8; bit++) {
+                        seed = seed * 1103515245 + 12345;
+
+                        if ((seed >> 1) < rate * 0x80000000UL) {
+                            byte ^= static_cast<uint8_t>(1 << bit);
+                            dropped = true;
+                        }
+                    }
+
+                    if (drop == 0) {
+                        corrupted.push_back(byte);
+                    }
+                    else if (!dropped) {
+                        corrupted.push_back(encoded[i]);
+                    }
+                }
+
+                static uint8_t resync[256];
+                size_t frames[2] = {0, 0};
+
+                for (size_t mode = 0; mode < 2; mode++) {
+                    TinyLinkDecoder decoder(buffer, sizeof(buffer));
+
+                    if (mode == 1) {
+                        decoder.setResyncBuffer(resync, sizeof(resync));
+                    }
+
+                    decoder.feed(corrupted.data(), corrupted.size(), countFrame, &frames[mode]);
+                }
+
+                printf("resync %s=%g frames=%zu plain=%.2f%% resync=%.2f%%\n", drop ? "drop" : "ber", rate, count, 100.0 * frames[0] / count, 100.0 * frames[1] / count);
+            }
+        }
+    }
+
+#ifdef TINYLINK_HAS_GATEWAY
+    {
+        // Aggregate frames per second of the gateway, for a growing number of
+        // links.
+        const size_t framesPerBlock = 64;
+        std::vector<uint8_t> encoded;
+
+        for (size_t i = 0; i < framesPerBlock; i++) {
+            const std::vector<uint8_t> payload = makePayload(32, static_cast<uint32_t>(i));
+            uint8_t frame[TinyLinkEncoder::maxEncodedLength(32)];
+
+            frame_t f;
+            f.flags = 0x0001;
+            f.length = static_cast<uint16_t>(payload.size());
+            f.payload = payload.data();
+
+            size_t length = TinyLinkEncoder::encode(&f, frame, sizeof(frame));
+
+            encoded.insert(encoded.end(), frame, frame + length);
+        }
+
+        const size_t counts[] = {1, 4, 16, 64};
+
+        for (size_t links : counts) {
+            const double rate = measureGateway(links, 256 * 1024, encoded, framesPerBlock);
+
+            printf("gateway links=%zu frames=%.0f/s\n", links, rate);
+        }
+
+        const size_t threads[] = {1, 2, 4, 8};
+
+        for (size_t count : threads) {
+            measureShardedGateway(count, 16, 256 * 1024);
+        }
+    }
+#endif
+
+#ifdef TINYLINK_HAS_CAPTURE
+    {
+        // Decoding a capture of 64 MiB, for a growing number of threads.
+        std::vector<uint8_t> capture;
+
+        for (uint32_t i = 0; capture.size() < 64 * 1024 * 1024; i++) {
+            const std::vector<uint8_t> payload = makePayload(16 + i % 1024, i);
+            uint8_t frame[TinyLinkEncoder::maxEncodedLength(1040)];
+
+            frame_t f;
+            f.flags = 0x0001;
+            f.length = static_cast<uint16_t>(payload.size());
+            f.payload = payload.data();
+
+            size_t length = TinyLinkEncoder::encode(&f, frame, sizeof(frame));
+
+            capture.insert(capture.end(), frame, frame + length);
+        }
+
+        const size_t threads[] = {1, 2, 4, 8};
+
+        for (size_t count : threads) {
+            std::vector<capture_frame_t> frames;
+
+            const auto start = std::chrono::steady_clock::now();
+
+            TinyLinkCapture::decode(capture.data(), capture.size(), count, count * 4, 0xFFFF, &frames);
+
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+            printf("capture threads=%zu frames=%zu rate=%.1f MB/s\n", count, frames.size(), capture.size() / elapsed.count() / 1e6);
+        }
+    }
+#endif
+
+    return 0;
+}
@@ -0,0 +1,284 @@
+#include <Crc.h>
+#include <Stream.h>
+#include <TinyLink.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+/**
+ * Benchmark suite that prints one JSON object per line, so runs can be
+ * compared by tools. Every benchmark reports the payload throughput, the time
+ * per frame, and the number of heap allocations while measuring.
+ */
+
+static size_t allocations = 0;
+
+void* operator new(size_t size) {
+    allocations++;
+
+    void* pointer = malloc(size ? size : 1);
+
+    if (pointer == NULL) {
+        throw std::bad_alloc();
+    }
+
+    return pointer;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    free(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+    free(pointer);
+}
+
+/**
+ * @brief Stream that discards written bytes into a buffer that is rewound per
+ * frame.
+ */
+class MemoryStream : public Stream {
+public:
+    explicit MemoryStream(size_t capacity) : data(capacity), index(0) {}
+
+    size_t write(uint8_t b) override {
+        data[index++ % data.size()] = b;
+        return 1;
+    }
+
+    size_t write(const uint8_t* buffer, size_t size) override {
+        if (index + size > data.size()) {
+            index = 0;
+        }
+
+        memcpy(&data[index], buffer, size);
+        index += size;
+
+        return size;
+    }
+
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    void flush() override {}
+
+    std::vector<uint8_t> data;
+    size_t index;
+};
+
+/**
+ * @brief Stream that reads back the bytes written to it. The buffer is
+ * rewound once all bytes are read.
+ */
+class LoopbackStream : public Stream {
+public:
+    explicit LoopbackStream(size_t capacity) : data(capacity), head(0), tail(0) {}
+
+    size_t write(uint8_t b) override {
+        return write(&b, 1);
+    }
+
+    size_t write(const uint8_t* buffer, size_t size) override {
+        if (head + size > data.size()) {
+            return 0;
+        }
+
+        memcpy(&data[head], buffer, size);
+        head += size;
+
+        return size;
+    }
+
+    int available() override { return static_cast<int>(head - tail); }
+
+    int read() override {
+        if (tail == head) {
+            return -1;
+        }
+
+        int value = data[tail++];
+
+        if (tail == head) {
+            head = tail = 0;
+        }
+
+        return value;
+    }
+
+    size_t readBytes(uint8_t* buffer, size_t length) override {
+        size_t count = head - tail < length ? head - tail : length;
+
+        memcpy(buffer, &data[tail], count);
+        tail += count;
+
+        if (tail == head) {
+            head = tail = 0;
+        }
+
+        return count;
+    }
+
+    int peek() override { return tail == head ? -1 : data[tail]; }
+    void flush() override {}
+
+    void load(const std::vector<uint8_t>& encoded) {
+        head = tail = 0;
+        write(encoded.data(), encoded.size());
+    }
+
+    std::vector<uint8_t> data;
+    size_t head;
+    size_t tail;
+};
+
+/**
+ * @brief Generate a payload. With density "none" there are no bytes that need
+ * escaping, with "random" the bytes are uniformly random, and with "all" every
+ * byte is 0xAA.
+ */
+static std::vector<uint8_t> makePayload(size_t length, const char* density) {
+    std::vector<uint8_t> result(length);
+    uint32_t seed = static_cast<uint32_t>(length);
+
+    for (size_t i = 0; i < length; i++) {
+        seed = seed * 1103515245 + 12345;
+
+        uint8_t value = static_cast<uint8_t>(seed >> 16);
+
+        if (strcmp(density, "all") == 0) {
+            value = FLAG;
+        }
+        else if (strcmp(density, "none") == 0 && (value == FLAG || value == ESCAPE)) {
+            value = 0x00;
+        }
+
+        result[i] = value;
+    }
+
+    return result;
+}
+
+/**
+ * @brief Run a benchmark until enough payload was processed, and print the
+ * result as a line of JSON.
+ */
+template <typename F>
+static void run(const char* name, const char* policy, size_t length, const char* density, F&& f) {
+    const size_t frames = (8 * 1024 * 1024) / (length + 1) + 1000;
+
+    // Warm up, without counting.
+    f();
+
+    const size_t before = allocations;
+    const auto start = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < frames; i++) {
+        f();
+    }
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    const size_t count = allocations - before;
+
+    printf("{\"benchmark\":\"%s\",\"policy\":\"%s\",\"length\":%zu,\"density\":\"%s\",\"frames\":%zu,"
+        "\"bytes_per_second\":%.0f,\"ns_per_frame\":%.1f,\"allocations\":%zu}\n",
+        name, policy, length, density, frames,
+        static_cast<double>(frames * length) / elapsed.count(), elapsed.count() * 1e9 / frames, count);
+}
+
+template <class Policy>
+static void runPolicy(const char* policy, size_t length, const char* density, const std::vector<uint8_t>& payload) {
+    static uint8_t buffer[8192];
+    static uint8_t readBuffer[8192];
+
+    frame_t frame;
+
+    frame.flags = 0x0001;
+    frame.length = static_cast<uint16_t>(length);
+    frame.payload = payload.data();
+
+    // Encode once, to have a frame to read.
+    LoopbackStream loopback(2 * TinyLinkEncoder::maxEncodedLength(8192));
+    BasicTinyLink<Policy> writer(loopback, buffer, sizeof(buffer));
+
+    writer.writeFrame(&frame);
+
+    const std::vector<uint8_t> encoded(loopback.data.begin(), loopback.data.begin() + loopback.head);
+
+    {
+        MemoryStream stream(2 * encoded.size());
+        BasicTinyLink<Policy> tinylink(stream, buffer, sizeof(buffer));
+
+        run("write", policy, length, density, [&]() {
+            tinylink.writeFrame(&frame);
+        });
+    }
+
+    {
+        BasicTinyLink<Policy> tinylink(loopback, readBuffer, sizeof(readBuffer));
+        frame_t decoded;
+
+        run("read", policy, length, density, [&]() {
+            loopback.load(encoded);
+
+            while (!tinylink.readFrame(&decoded)) {
+            }
+        });
+
+        run("poll", policy, length, density, [&]() {
+            loopback.load(encoded);
+
+            while (!tinylink.pollFrame(&decoded)) {
+            }
+        });
+    }
+
+    {
+        BasicTinyLink<Policy> tinylink(loopback, readBuffer, sizeof(readBuffer));
+        frame_t decoded;
+
+        loopback.load(std::vector<uint8_t>());
+
+        run("roundtrip", policy, length, density, [&]() {
+            tinylink.writeFrame(&frame);
+
+            while (!tinylink.pollFrame(&decoded)) {
+            }
+        });
+    }
+}
+
+int main() {
+    const size_t lengths[] = {16, 64, 256, 1024, 4096};
+    const char* densities[] = {"none", "random", "all"};
+
+    for (size_t length : lengths) {
+        for (const char* density : densities) {
+            const std::vector<uint8_t> payload = makePayload(length, density);
+
+            run("crc", "none", length, density, [&]() {
+                volatile uint32_t crc = CRC32(0, payload.data(), payload.size());
+                (void) crc;
+            });
+
+            runPolicy<TinyLinkStuffingPolicy>("stuffing", length, density, payload);
+            runPolicy<TinyLinkCobsPolicy>("cobs", length, density, payload);
+        }
+    }
+
+    return 0;
+}
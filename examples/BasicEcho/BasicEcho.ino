@@ -19,15 +19,14 @@ void loop()
 {
     frame_t frame;
 
-    if (Serial.available()) {
-        if (tinylink.readFrame(&frame)) {
-            // Toggle led based on the flags value.
+    // Process all bytes available, until a frame is complete.
+    if (tinylink.pollFrame(&frame)) {
+        // Toggle led based on the flags value.
 #ifdef LED_BUILTIN
-            digitalWrite(LED_BUILTIN, frame.flags != 0);
+        digitalWrite(LED_BUILTIN, frame.flags != 0);
 #endif
 
-            // Echo the frame.
-            tinylink.writeFrame(&frame);
-        }
+        // Echo the frame.
+        tinylink.writeFrame(&frame);
     }
 }
@@ -5,7 +5,43 @@
 
 #define CRC32_POLYNOMIAL 0xEDB88320L
 
+// Available CRC32 backends. All backends produce identical results.
+#define CRC32_BACKEND_BITWISE   1
+#define CRC32_BACKEND_TABLE     2
+#define CRC32_BACKEND_SLICING8  3
+#define CRC32_BACKEND_HARDWARE  4
+
+// Select a backend at compile time. Define CRC32_BACKEND (e.g. using build
+// flags) to override the default choice for a platform.
+//
+// - Bitwise: eight shift/xor iterations per byte, no tables.
+// - Table: one lookup per byte in a 256-entry table (1 KiB, PROGMEM on AVR).
+// - Slicing-by-8: eight lookups per eight bytes in 8 tables (8 KiB).
+// - Hardware: CRC32 instructions on ARMv8, ROM routine on ESP32.
+#ifndef CRC32_BACKEND
+    #if defined(__ARM_FEATURE_CRC32)
+        #define CRC32_BACKEND CRC32_BACKEND_HARDWARE
+    #elif defined(__AVR__)
+        #define CRC32_BACKEND CRC32_BACKEND_TABLE
+    #else
+        #define CRC32_BACKEND CRC32_BACKEND_SLICING8
+    #endif
+#endif
+
 uint32_t CRC32(uint32_t initial, const uint8_t* buffer, size_t length);
 uint32_t CRC32(uint32_t initial, uint8_t value);
 uint32_t CRC32(const uint8_t* buffer, size_t length);
 uint32_t CRC32(uint8_t value);
+
+/**
+ * @brief Compute the CRC32 bit by bit, regardless of the selected backend.
+ *
+ * This is the reference implementation that all other backends are checked
+ * against.
+ *
+ * @param initial   The initial CRC value.
+ * @param buffer    The data to compute the CRC over.
+ * @param length    The length of the data.
+ * @return uint32_t The updated CRC value.
+ */
+uint32_t CRC32Bitwise(uint32_t initial, const uint8_t* buffer, size_t length);
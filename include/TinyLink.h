@@ -2,41 +2,38 @@
 
 #include <Stream.h>
 
-// This can be anything, and is used to synchronize a frame.
-#define PREAMBLE        0xAA55AA55
-
-// The escape character is used for byte-stuffing of the header and body.
-#define FLAG            0xAA
-#define ESCAPE          0x1B
-
-// Do not change the values below!
-#define LEN_PREAMBLE    4
-
-#define LEN_FLAGS       2
-#define LEN_LENGTH      2
-#define LEN_XOR         1
-#define LEN_HEADER      (LEN_FLAGS + LEN_LENGTH + LEN_XOR)
-
-#define LEN_CRC         4
-#define LEN_BODY        LEN_CRC
-
-// Protocol states.
-typedef enum {
-    WAITING_FOR_PREAMBLE = 1,
-    WAITING_FOR_HEADER,
-    WAITING_FOR_BODY
-} tinylink_state_e;
-
-struct frame_t {
-    uint16_t length;
-    uint16_t flags;
-    const uint8_t* payload;
-};
+#include "TinyLinkDecoder.h"
+#include "TinyLinkEncoder.h"
+#include "TinyLinkPolicy.h"
+#include "TinyLinkProtocol.h"
+#include "TinyLinkStats.h"
+
+// Size of the block used to batch writes to the stream. Runs of bytes that do
+// not need escaping and do not fit in this block are written directly.
+#ifndef TINYLINK_WRITE_BLOCK_SIZE
+#define TINYLINK_WRITE_BLOCK_SIZE 32
+#endif
+
+// Size of the block used to read from the stream in `pollFrame`.
+#ifndef TINYLINK_READ_BLOCK_SIZE
+#define TINYLINK_READ_BLOCK_SIZE 32
+#endif
 
-class TinyLink {
+/**
+ * @brief Link that reads and writes frames using a stream.
+ *
+ * The framing policy is selected at compile time. Use `TinyLink` for the
+ * default byte-stuffing policy, or `BasicTinyLink<TinyLinkCobsPolicy>` for a
+ * bounded overhead when both ends of the link support it.
+ *
+ * @tparam Policy   The framing policy, `TinyLinkStuffingPolicy` or
+ *                  `TinyLinkCobsPolicy`.
+ */
+template <class Policy>
+class BasicTinyLink {
 public:
     /**
-     * @brief Construct a new TinyLink object.
+     * @brief Construct a new BasicTinyLink object.
      *
      * The size of the buffer should be large enough to hold the header and the
      * body, taking into account that the data in the body is byte-stuffed. That
@@ -46,17 +43,86 @@ public:
      * @param _buffer   The buffer to use.
      * @param _length   The length of the buffer.
      */
-    TinyLink(Stream& _stream, uint8_t* _buffer, size_t _length);
+    BasicTinyLink(Stream& _stream, uint8_t* _buffer, size_t _length);
 
     /**
      * @brief Read a frame from the stream.
      *
+     * At most one byte is consumed per call.
+     *
      * @param frame     The frame to read into.
      * @return true     If a frame was read.
      * @return false    If no frame was read.
      */
     bool readFrame(frame_t* frame);
 
+    /**
+     * @brief Read a frame from the stream, consuming all bytes available.
+     *
+     * Bytes are read in blocks, and processed until a frame is complete.
+     * Remaining bytes are kept for the next call. Unlike `readFrame`, there is
+     * no need to check if the stream has data available first.
+     *
+     * @param frame     The frame to read into.
+     * @return true     If a frame was read.
+     * @return false    If no frame was read.
+     */
+    bool pollFrame(frame_t* frame);
+
+    /**
+     * @brief Receive the payload of frames in chunks, instead of at once.
+     *
+     * See `TinyLinkDecoder::setChunkCallback` for details.
+     *
+     * @param callback  The callback to invoke, or NULL to disable.
+     * @param context   The context to pass to the callback.
+     * @return true     If the callback was set.
+     * @return false    If the buffer is too short to hold a chunk.
+     */
+    bool setChunkCallback(tinylink_chunk_callback_t callback, void* context);
+
+    /**
+     * @brief Read the payload of frames directly into a destination.
+     *
+     * See `TinyLinkDecoder::setDestination` for details.
+     *
+     * @param buffer    The destination, or NULL to disable.
+     * @param length    The length of the destination.
+     */
+    void setDestination(void* buffer, uint16_t length);
+
+    /**
+     * @brief Select the destination of the payload per frame.
+     *
+     * See `TinyLinkDecoder::setDestinationCallback` for details.
+     *
+     * @param callback  The callback to invoke, or NULL to disable.
+     * @param context   The context to pass to the callback.
+     */
+    void setDestinationCallback(tinylink_destination_callback_t callback, void* context);
+
+    /**
+     * @brief Recover frames that start inside a corrupted frame.
+     *
+     * See `TinyLinkDecoder::setResyncBuffer` for details.
+     *
+     * @param buffer    The buffer to use, or NULL to disable.
+     * @param length    The length of the buffer.
+     */
+    void setResyncBuffer(void* buffer, size_t length);
+
+    /**
+     * @brief Abort a partial frame when bytes stop arriving.
+     *
+     * See `TinyLinkDecoder::setTimeout` for details.
+     *
+     * @param clock         The clock to use, for example `millis`, or NULL to
+     *                      disable.
+     * @param byteTimeout   The inter-byte timeout, or zero to disable.
+     * @param frameTimeout  The frame timeout, or zero to disable.
+     */
+    void setTimeout(tinylink_clock_callback_t clock, uint32_t byteTimeout, uint32_t frameTimeout);
+
     /**
      * @brief Read data from the stream directly into a buffer.
      *
@@ -81,6 +147,21 @@ public:
      */
     bool writeFrame(const frame_t* frame);
 
+    /**
+     * @brief Write a frame with a payload split across multiple segments.
+     *
+     * The segments are written in order, without copying them first. The
+     * result is identical to writing a frame with the concatenated segments
+     * as payload.
+     *
+     * @param flags     The flags to use.
+     * @param segments  The segments of the payload.
+     * @param count     The number of segments.
+     * @return true     If the frame was written.
+     * @return false    If the frame was not written.
+     */
+    bool writeFrame(const uint16_t flags, const segment_t* segments, const size_t count);
+
     /**
      * @brief Write data from a buffer to the stream.
      *
@@ -91,19 +172,117 @@ public:
      * @return false    If the data was not written.
      */
     bool write(const uint16_t flags, const void* payload, const uint16_t length);
-private:
-    void writeStream(bool preamble, const uint8_t* buffer, const uint16_t length);
 
-    uint8_t checksumHeader(const uint16_t flags, const uint16_t length);
-    uint32_t checksumFrame(const uint8_t* header, const uint8_t* payload, const uint16_t length);
+    /**
+     * @brief Start writing a frame of which the payload is appended later.
+     *
+     * The payload is appended in pieces using `appendFrame`, and the frame is
+     * finished using `endFrame`. The checksum is updated while appending, so
+     * the payload never has to be in memory at once.
+     *
+     * @param flags     The flags to use.
+     * @param length    The total length of the payload.
+     * @return true     If the frame was started.
+     * @return false    If the length is too large, or another frame is being
+     *                  written.
+     */
+    bool beginFrame(const uint16_t flags, const uint16_t length);
+
+    /**
+     * @brief Append a piece of payload to the frame being written.
+     *
+     * @param payload   The piece of payload to write.
+     * @param length    The length of the piece.
+     * @return true     If the piece was written.
+     * @return false    If no frame is being written, or if the piece exceeds
+     *                  the length passed to `beginFrame`.
+     */
+    bool appendFrame(const void* payload, const uint16_t length);
+
+    /**
+     * @brief Finish the frame being written, by writing the checksum.
+     *
+     * If less payload was appended than announced, the frame is aborted and
+     * the other side will discard it.
+     *
+     * @return true     If the frame was finished.
+     * @return false    If no frame is being written, or if the frame is
+     *                  incomplete.
+     */
+    bool endFrame();
+
+    /**
+     * @brief Set the maximum length of the payload of frames written.
+     *
+     * By default, this is the length of the buffer passed to the constructor.
+     * It is independent of the buffer, and can be set higher for peers that
+     * accept larger frames.
+     *
+     * @param length    The maximum length of the payload.
+     */
+    void setMaxWriteLength(const uint16_t length);
+
+#if TINYLINK_STATS
+    /**
+     * @brief Return the statistics of the frames received and written. Only
+     * available if `TINYLINK_STATS` is enabled.
+     *
+     * @return tinylink_stats_t The statistics.
+     */
+    tinylink_stats_t getStats() const;
+
+    /**
+     * @brief Reset all counters to zero.
+     */
+    void resetStats();
+#endif
+
+#if TINYLINK_TRACE
+    /**
+     * @brief Set the callback invoked when a frame begins and ends, for both
+     * directions. Only available if `TINYLINK_TRACE` is enabled.
+     *
+     * @param callback  The callback to invoke, or NULL to disable.
+     * @param context   The context to pass to the callback.
+     */
+    void setTraceCallback(tinylink_trace_callback_t callback, void* context);
+#endif
+private:
+    void writeStream(bool preamble, const uint8_t* buffer, const uint16_t length, uint32_t* checksum);
+    void writeEncoded(const uint8_t* buffer, const size_t length);
+    void writeRun(const uint8_t* buffer, const size_t length);
+    void finishEncoded();
+    void writeBlock(const uint8_t* buffer, const size_t length);
+    void flushBlock();
+    bool drainFrame(frame_t* frame);
 
     Stream& stream;
 
-    uint16_t length;
-    uint8_t* buffer;
+    BasicTinyLinkDecoder<Policy> decoder;
+
+    uint16_t maxWriteLength;
 
-    size_t index;
-    bool unescaping;
+    bool writing;
+    uint16_t writeRemaining;
+    uint32_t writeChecksum;
 
-    tinylink_state_e state;
+    typename Policy::encoder_t encoder;
+
+    uint8_t block[TINYLINK_WRITE_BLOCK_SIZE];
+    size_t blockIndex;
+
+    uint8_t readBlock[TINYLINK_READ_BLOCK_SIZE];
+    size_t readBlockIndex;
+    size_t readBlockLength;
+
+#if TINYLINK_STATS
+    tinylink_stats_t stats;
+#endif
+
+#if TINYLINK_TRACE
+    tinylink_trace_callback_t traceCallback;
+    void* traceContext;
+#endif
 };
+
+typedef BasicTinyLink<TinyLinkStuffingPolicy> TinyLink;
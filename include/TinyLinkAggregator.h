@@ -0,0 +1,141 @@
+#pragma once
+
+#include "TinyLink.h"
+#include "TinyLinkProtocol.h"
+
+// Every aggregated message is prefixed with its length.
+#define LEN_MESSAGE_PREFIX 1
+
+/**
+ * @brief Pack multiple small messages into one frame.
+ *
+ * Messages are prefixed with their length (at most 255 bytes) and collected
+ * in a buffer. The buffer is written as one frame with `FLAGS_AGGREGATE` set
+ * when the next message does not fit, when the timeout expires, or when
+ * `flush` is called. Use `TinyLinkUnpacker` to iterate over the messages of a
+ * received frame.
+ *
+ * @tparam Policy   The framing policy of the link, `TinyLinkStuffingPolicy` or
+ *                  `TinyLinkCobsPolicy`.
+ */
+template <class Policy>
+class BasicTinyLinkAggregator {
+public:
+    /**
+     * @brief Construct a new BasicTinyLinkAggregator object.
+     *
+     * The length of the buffer determines the maximum payload of a frame, and
+     * should not exceed the maximum write length of the link.
+     *
+     * @param _link     The link to write frames to.
+     * @param _buffer   The buffer to collect messages in.
+     * @param _length   The length of the buffer.
+     */
+    BasicTinyLinkAggregator(BasicTinyLink<Policy>& _link, uint8_t* _buffer, size_t _length);
+
+    /**
+     * @brief Add a message to the current frame. The current frame is written
+     * first if the message does not fit.
+     *
+     * @param message   The message to add.
+     * @param length    The length of the message.
+     * @return true     If the message was added.
+     * @return false    If the message can never fit, or writing the current
+     *                  frame failed. The messages already added are kept.
+     */
+    bool write(const void* message, const uint8_t length);
+
+    /**
+     * @brief Write the current frame, if it contains messages. If writing
+     * fails, the messages are kept, and written on the next attempt.
+     *
+     * @return true     If the frame was written, or there was nothing to write.
+     * @return false    If writing the frame failed.
+     */
+    bool flush();
+
+    /**
+     * @brief Write the current frame if the timeout expired. Call this
+     * regularly when a timeout is set.
+     *
+     * @return true     If the frame was written.
+     * @return false    If there was nothing to write, the timeout did not
+     *                  expire yet, or writing the frame failed.
+     */
+    bool poll();
+
+    /**
+     * @brief Set the timeout after which a frame is written, counted from the
+     * first message in the frame.
+     *
+     * @param clock     The clock to use, or NULL to disable the timeout.
+     * @param timeout   The timeout, in units of the clock.
+     */
+    void setTimeout(tinylink_clock_callback_t clock, uint32_t timeout);
+
+    /**
+     * @brief Set additional flags for the frames that are written.
+     * `FLAGS_AGGREGATE` is always set.
+     *
+     * @param flags     The flags to set.
+     */
+    void setFlags(const uint16_t flags);
+
+    /**
+     * @brief Return the number of bytes in the current frame.
+     *
+     * @return size_t   The number of bytes, including the length prefixes.
+     */
+    size_t getPending() const;
+private:
+    BasicTinyLink<Policy>& link;
+
+    uint8_t* buffer;
+    size_t length;
+    size_t index;
+
+    uint16_t flags;
+
+    tinylink_clock_callback_t clock;
+    uint32_t timeout;
+    uint32_t started;
+};
+
+typedef BasicTinyLinkAggregator<TinyLinkStuffingPolicy> TinyLinkAggregator;
+
+/**
+ * @brief Iterate over the messages of an aggregated frame.
+ */
+class TinyLinkUnpacker {
+public:
+    /**
+     * @brief Construct a new TinyLinkUnpacker object.
+     *
+     * @param _frame    The frame to unpack. A frame without `FLAGS_AGGREGATE`
+     *                  contains no messages.
+     */
+    TinyLinkUnpacker(const frame_t* _frame);
+
+    /**
+     * @brief Return the next message.
+     *
+     * @param message   Set to the start of the message in the frame.
+     * @param length    Set to the length of the message.
+     * @return true     If a message was returned.
+     * @return false    If there are no more messages, or the frame is
+     *                  malformed.
+     */
+    bool next(const uint8_t** message, uint8_t* length);
+
+    /**
+     * @brief Return true if a frame carries aggregated messages.
+     *
+     * @param frame     The frame to check.
+     * @return true     If `FLAGS_AGGREGATE` is set.
+     * @return false    Otherwise.
+     */
+    static bool isAggregate(const frame_t* frame);
+private:
+    const uint8_t* data;
+    const uint8_t* end;
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+// Decoding captures is available on hosts only.
+#if (defined(__linux__) || defined(__APPLE__)) && !defined(ARDUINO)
+#define TINYLINK_HAS_CAPTURE 1
+#endif
+
+#ifdef TINYLINK_HAS_CAPTURE
+
+#include "TinyLinkProtocol.h"
+
+#include <vector>
+
+// A frame found in a capture.
+struct capture_frame_t {
+    uint64_t offset;
+    uint16_t flags;
+    uint16_t length;
+    bool valid;
+};
+
+/**
+ * @brief Decoder of captures of raw traffic, such as recordings of a serial
+ * line.
+ *
+ * The capture is split into chunks at candidate preambles, and the chunks are
+ * decoded in parallel, each by a `TinyLinkDecoder` that waits for a preamble
+ * at its start. Afterwards, the decoder in the actual state continues across
+ * every boundary until it finds the preamble of a frame that the next chunk
+ * found as well. From there on, both decoders are in the same state. The
+ * result is therefore exactly the same as decoding the capture in one go.
+ */
+class TinyLinkCapture {
+public:
+    /**
+     * @brief Decode a capture in memory.
+     *
+     * Every frame with a valid header is reported, with its offset (of the
+     * preamble), flags, length and whether its CRC is valid. Like the decoder
+     * of a link, headers with a length above `maxLength` are rejected.
+     *
+     * @param data      The capture.
+     * @param length    The length of the capture.
+     * @param threads   The number of threads to use.
+     * @param chunks    The number of chunks to split the capture into.
+     * @param maxLength The maximum length of the payload of a frame.
+     * @param frames    The frames found, in order of their offset.
+     */
+    static void decode(const uint8_t* data, size_t length, size_t threads, size_t chunks, uint16_t maxLength, std::vector<capture_frame_t>* frames);
+
+    /**
+     * @brief Decode a capture file, which is mapped into memory.
+     *
+     * @param path      The path of the file.
+     * @param threads   The number of threads to use.
+     * @param frames    The frames found, in order of their offset.
+     * @return true     If the file was decoded.
+     * @return false    If the file could not be mapped.
+     */
+    static bool decodeFile(const char* path, size_t threads, std::vector<capture_frame_t>* frames);
+};
+
+#endif
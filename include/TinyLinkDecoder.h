@@ -0,0 +1,346 @@
+#pragma once
+
+#include "TinyLinkPolicy.h"
+#include "TinyLinkProtocol.h"
+#include "TinyLinkStats.h"
+
+/**
+ * @brief Callback invoked for every frame decoded by `TinyLinkDecoder::feed`.
+ *
+ * The payload of the frame is only valid during the callback.
+ *
+ * @param frame     The decoded frame.
+ * @param context   The context passed to `TinyLinkDecoder::feed`.
+ */
+typedef void (*tinylink_frame_callback_t)(const frame_t* frame, void* context);
+
+// Events of the chunk callback.
+typedef enum {
+    CHUNK_DATA = 1,
+    CHUNK_VALID,
+    CHUNK_INVALID
+} tinylink_chunk_e;
+
+// A chunk of payload, received in chunks.
+struct chunk_t {
+    uint16_t flags;
+    uint16_t length;
+    uint16_t offset;
+    uint16_t size;
+    const uint8_t* data;
+};
+
+/**
+ * @brief Callback invoked when receiving frames in chunks.
+ *
+ * For `CHUNK_DATA`, the chunk contains `size` bytes of payload at `offset`.
+ * The data is only valid during the callback. After the last chunk, the
+ * callback is invoked once more with `CHUNK_VALID` or `CHUNK_INVALID`,
+ * depending on the CRC of the frame. For these events, `offset` and `size` are
+ * zero.
+ *
+ * @param event     The event.
+ * @param chunk     The chunk. The flags and (total) length are always set.
+ * @param context   The context passed to `setChunkCallback`.
+ */
+typedef void (*tinylink_chunk_callback_t)(tinylink_chunk_e event, const chunk_t* chunk, void* context);
+
+/**
+ * @brief Callback invoked to select the destination of the payload of a frame.
+ *
+ * @param flags     The flags of the frame.
+ * @param length    The length of the payload.
+ * @param context   The context passed to `setDestinationCallback`.
+ * @return uint8_t* A destination of at least `length` bytes, or NULL to
+ *                  decode into the buffer of the decoder.
+ */
+typedef uint8_t* (*tinylink_destination_callback_t)(uint16_t flags, uint16_t length, void* context);
+
+/**
+ * @brief Decoder of frames, independent of a stream.
+ *
+ * @tparam Policy   The framing policy, `TinyLinkStuffingPolicy` or
+ *                  `TinyLinkCobsPolicy`.
+ */
+template <class Policy>
+class BasicTinyLinkDecoder {
+public:
+    /**
+     * @brief Construct a new BasicTinyLinkDecoder object.
+     *
+     * The decoder does not depend on a stream, and decodes bytes that are
+     * pushed into it. The buffer holds the unescaped header and body of the
+     * frame being decoded.
+     *
+     * @param _buffer   The buffer to use.
+     * @param _length   The length of the buffer.
+     */
+    BasicTinyLinkDecoder(uint8_t* _buffer, size_t _length);
+
+    /**
+     * @brief Reset the decoder, discarding a partially decoded frame.
+     */
+    void reset();
+
+    /**
+     * @brief Push a single byte into the decoder.
+     *
+     * @param byte      The byte to push.
+     * @param frame     The frame to read into.
+     * @return true     If a frame was decoded.
+     * @return false    If no frame was decoded.
+     */
+    bool push(uint8_t byte, frame_t* frame);
+
+    /**
+     * @brief Push bytes into the decoder, until a frame is decoded.
+     *
+     * Decoding stops after the byte that completes a frame, so the payload can
+     * be processed before the next frame is decoded. Call this method again
+     * with the remaining bytes to continue. Frames recovered from a rejected
+     * frame may still be pending, which an empty span decodes.
+     *
+     * @param data      The bytes to push.
+     * @param length    The number of bytes to push.
+     * @param consumed  The number of bytes consumed.
+     * @param frame     The frame to read into.
+     * @return true     If a frame was decoded.
+     * @return false    If all bytes were consumed without decoding a frame.
+     */
+    bool feed(const uint8_t* data, size_t length, size_t* consumed, frame_t* frame);
+
+    /**
+     * @brief Push bytes into the decoder, invoking a callback for every frame
+     * decoded.
+     *
+     * @param data      The bytes to push.
+     * @param length    The number of bytes to push.
+     * @param callback  The callback to invoke.
+     * @param context   The context to pass to the callback.
+     * @return size_t   The number of frames decoded.
+     */
+    size_t feed(const uint8_t* data, size_t length, tinylink_frame_callback_t callback, void* context);
+
+    /**
+     * @brief Receive the payload of frames in chunks, instead of at once.
+     *
+     * The payload is passed to the callback in chunks as it arrives, so the
+     * length of a frame is no longer limited by the length of the buffer.
+     * Chunks are as large as the buffer minus the header (5 bytes). Frames are
+     * no longer returned by `push` and `feed`. This mode takes precedence over
+     * a destination set using `setDestination` or `setDestinationCallback`.
+     *
+     * Any partially decoded frame is discarded. The buffer must be longer than
+     * the header, otherwise chunk mode is rejected and left unchanged.
+     *
+     * @param callback  The callback to invoke, or NULL to disable.
+     * @param context   The context to pass to the callback.
+     * @return true     If the callback was set.
+     * @return false    If the buffer is too short to hold a chunk.
+     */
+    bool setChunkCallback(tinylink_chunk_callback_t callback, void* context);
+
+    /**
+     * @brief Decode the payload of frames directly into a destination.
+     *
+     * The payload is not copied into the buffer of the decoder, which then
+     * only needs to hold the header. The payload of decoded frames points to
+     * the destination. Frames that do not fit are discarded without touching
+     * the destination. If the CRC of a frame does not match, or if a frame is
+     * interrupted by a reset, the first `length` bytes of the destination are
+     * cleared.
+     *
+     * Any partially decoded frame is discarded.
+     *
+     * @param buffer    The destination, or NULL to disable.
+     * @param length    The length of the destination.
+     */
+    void setDestination(void* buffer, uint16_t length);
+
+    /**
+     * @brief Select the destination of the payload per frame.
+     *
+     * This works like `setDestination`, except that the destination is
+     * selected by a callback, based on the flags and length of the frame. This
+     * callback takes precedence over `setDestination`.
+     *
+     * Any partially decoded frame is discarded.
+     *
+     * @param callback  The callback to invoke, or NULL to disable.
+     * @param context   The context to pass to the callback.
+     */
+    void setDestinationCallback(tinylink_destination_callback_t callback, void* context);
+
+    /**
+     * @brief Reject frames with a payload longer than the given length.
+     *
+     * Frames are rejected after the header, like frames that do not fit in
+     * the buffer or the destination. This also limits the length of frames
+     * received in chunks, which is not limited otherwise.
+     *
+     * @param length    The maximum length of the payload.
+     */
+    void setMaxLength(uint16_t length);
+
+    /**
+     * @brief Recover frames that start inside a corrupted frame.
+     *
+     * After a preamble, the received bytes are kept in the given buffer. When
+     * the header or the CRC turns out to be invalid, these bytes are scanned
+     * for a preamble again, instead of being dropped. Frames that are longer
+     * than the buffer (including escaping) are not scanned again. Bytes that
+     * arrive while the buffer is full of bytes to scan are queued after the
+     * bytes are scanned, so they are never dropped. A frame found by scanning
+     * again that does not fit is abandoned, and decoding continues where it
+     * would have without scanning again, so no frame is lost that would have
+     * been received without a buffer.
+     *
+     * Any partially decoded frame is discarded.
+     *
+     * @param buffer    The buffer to use, or NULL to disable.
+     * @param length    The length of the buffer.
+     */
+    void setResyncBuffer(void* buffer, size_t length);
+
+    /**
+     * @brief Abort a partial frame when bytes stop arriving.
+     *
+     * The clock is read once per call to `push` or `feed`. A partial frame is
+     * aborted when the time since the previous call exceeds the inter-byte
+     * timeout, or the time since the preamble exceeds the frame timeout. The
+     * preamble search then starts again with the bytes passed in that call.
+     * Calls without bytes do not count as the arrival of bytes.
+     *
+     * @param clock         The clock to use, or NULL to disable.
+     * @param byteTimeout   The inter-byte timeout, or zero to disable.
+     * @param frameTimeout  The frame timeout, or zero to disable.
+     */
+    void setTimeout(tinylink_clock_callback_t clock, uint32_t byteTimeout, uint32_t frameTimeout);
+
+    /**
+     * @brief Abort a partial frame if it timed out. This is done when bytes
+     * arrive, but can also be called to release a partial frame early.
+     *
+     * @return true     If a partial frame was aborted.
+     * @return false    Otherwise.
+     */
+    bool expire();
+
+    /**
+     * @brief Return the current state of the decoder.
+     *
+     * @return tinylink_state_e The current state.
+     */
+    tinylink_state_e getState() const;
+
+    /**
+     * @brief Return the offset of the preamble of the last frame found, in
+     * bytes pushed into the decoder since it was constructed. This is valid
+     * in the callbacks of a frame, and after a frame is returned.
+     *
+     * @return size_t   The offset, which wraps around on overflow.
+     */
+    size_t getFrameOffset() const;
+
+#if TINYLINK_STATS
+    /**
+     * @brief Return the statistics of the frames received. Only available if
+     * `TINYLINK_STATS` is enabled.
+     *
+     * @return const tinylink_stats_t& The statistics.
+     */
+    const tinylink_stats_t& getStats() const;
+
+    /**
+     * @brief Reset all counters to zero.
+     */
+    void resetStats();
+#endif
+
+#if TINYLINK_TRACE
+    /**
+     * @brief Set the callback invoked when a frame begins and ends. Only
+     * available if `TINYLINK_TRACE` is enabled.
+     *
+     * @param callback  The callback to invoke, or NULL to disable.
+     * @param context   The context to pass to the callback.
+     */
+    void setTraceCallback(tinylink_trace_callback_t callback, void* context);
+#endif
+private:
+    bool process(uint8_t byte, frame_t* frame);
+    bool step(uint8_t byte, frame_t* frame);
+    size_t receive(const uint8_t* data, size_t length);
+    bool replay(frame_t* frame);
+    size_t hunt(const uint8_t* data, size_t length);
+    void synchronize();
+    void skip(size_t count);
+    void restart();
+    bool backtrack(size_t mark, uint32_t window);
+    void resume();
+    bool abandon();
+    void trim();
+    bool expire(uint32_t now);
+    void deliverChunk(tinylink_chunk_e event);
+    uint8_t* selectPayload(uint16_t flags, uint16_t length);
+    void discardPayload();
+
+    size_t length;
+    uint8_t* buffer;
+
+    size_t index;
+    uint32_t window;
+    Policy policy;
+    uint32_t checksum;
+
+    uint16_t frameFlags;
+    uint16_t frameLength;
+    uint16_t maxLength;
+
+    // Offset of the next byte to decode, and of the preamble of the frame.
+    size_t position;
+    size_t frameOffset;
+
+    uint8_t* payload;
+    size_t payloadIndex;
+
+    uint8_t trailer[LEN_CRC];
+
+    tinylink_chunk_callback_t chunkCallback;
+    void* chunkContext;
+
+    uint8_t* destination;
+    uint16_t destinationLength;
+    tinylink_destination_callback_t destinationCallback;
+    void* destinationContext;
+
+    uint8_t* resync;
+    size_t resyncSize;
+    size_t resyncLength;
+    size_t resyncIndex;
+    bool resyncOverflow;
+
+    size_t resyncMark;
+    uint32_t resyncMarkWindow;
+    bool resyncMarked;
+
+    tinylink_clock_callback_t clock;
+    uint32_t byteTimeout;
+    uint32_t frameTimeout;
+    uint32_t byteTime;
+    uint32_t frameTime;
+
+#if TINYLINK_STATS
+    tinylink_stats_t stats;
+    uint8_t hunted;
+#endif
+
+#if TINYLINK_TRACE
+    tinylink_trace_callback_t traceCallback;
+    void* traceContext;
+#endif
+
+    tinylink_state_e state;
+};
+
+typedef BasicTinyLinkDecoder<TinyLinkStuffingPolicy> TinyLinkDecoder;
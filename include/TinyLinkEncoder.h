@@ -0,0 +1,89 @@
+#pragma once
+
+#include "TinyLinkProtocol.h"
+
+// Size of the spans in which data is checksummed and escaped when writing. A
+// span should fit in the data cache, so it is read from memory only once.
+#ifndef TINYLINK_WRITE_SPAN_SIZE
+#define TINYLINK_WRITE_SPAN_SIZE 512
+#endif
+
+/**
+ * @brief Callback invoked by `TinyLinkEncoder::encode` for every run of
+ * encoded bytes.
+ *
+ * @param data      The encoded bytes.
+ * @param length    The number of encoded bytes.
+ * @param context   The context passed to `TinyLinkEncoder::encode`.
+ */
+typedef void (*tinylink_write_callback_t)(const uint8_t* data, size_t length, void* context);
+
+class TinyLinkEncoder {
+public:
+    /**
+     * @brief Return the worst-case length of an encoded frame.
+     *
+     * In the worst case, every byte of the header, payload and CRC needs
+     * escaping. This can be used to size buffers at compile time.
+     *
+     * @param length    The length of the payload.
+     * @return size_t   The maximum length of the encoded frame.
+     */
+    static constexpr size_t maxEncodedLength(size_t length)
+    {
+        return LEN_PREAMBLE + 2 * (LEN_HEADER + length + LEN_CRC);
+    }
+
+    /**
+     * @brief Return the exact length of an encoded frame.
+     *
+     * This requires a pass over the payload, to compute the CRC and to count
+     * the bytes that need escaping.
+     *
+     * @param frame     The frame to encode.
+     * @return size_t   The length of the encoded frame.
+     */
+    static size_t encodedLength(const frame_t* frame);
+
+    /**
+     * @brief Encode a frame into a buffer.
+     *
+     * The encoded frame consists of the preamble, followed by the byte-stuffed
+     * header, payload and CRC. It is identical to what `TinyLink::writeFrame`
+     * writes to the stream.
+     *
+     * @param frame     The frame to encode.
+     * @param buffer    The buffer to encode into.
+     * @param length    The length of the buffer.
+     * @return size_t   The number of bytes written, or zero if the buffer is too
+     *                  small.
+     */
+    static size_t encode(const frame_t* frame, uint8_t* buffer, size_t length);
+
+    /**
+     * @brief Encode a frame, passing the encoded bytes to a callback.
+     *
+     * The encoded frame is passed in runs, e.g. to write it into a ring
+     * buffer. Runs of payload that do not need escaping are passed without
+     * copying.
+     *
+     * @param frame     The frame to encode.
+     * @param callback  The callback to invoke for every run.
+     * @param context   The context to pass to the callback.
+     */
+    static void encode(const frame_t* frame, tinylink_write_callback_t callback, void* context);
+
+    /**
+     * @brief Encode multiple frames back to back into a buffer.
+     *
+     * Frames are encoded in order, until a frame does not fit.
+     *
+     * @param frames    The frames to encode.
+     * @param count     The number of frames.
+     * @param buffer    The buffer to encode into.
+     * @param length    The length of the buffer.
+     * @param encoded   The number of frames encoded.
+     * @return size_t   The number of bytes written.
+     */
+    static size_t encode(const frame_t* frames, size_t count, uint8_t* buffer, size_t length, size_t* encoded);
+};
@@ -0,0 +1,185 @@
+#pragma once
+
+// The gateway is available on Linux hosts only.
+#if defined(__linux__) && !defined(ARDUINO)
+#define TINYLINK_HAS_GATEWAY 1
+#endif
+
+#ifdef TINYLINK_HAS_GATEWAY
+
+#include "TinyLinkDecoder.h"
+#include "TinyLinkProtocol.h"
+
+// Size of the block read from a file descriptor at once.
+#ifndef TINYLINK_GATEWAY_READ_SIZE
+#define TINYLINK_GATEWAY_READ_SIZE 4096
+#endif
+
+// Size of the buffer of encoded frames waiting to be written, per link.
+#ifndef TINYLINK_GATEWAY_WRITE_SIZE
+#define TINYLINK_GATEWAY_WRITE_SIZE 16384
+#endif
+
+/**
+ * @brief Callback invoked for every frame received by the gateway. Links must
+ * not be removed from within the callback.
+ *
+ * A link that is closed by the other side is reported once, when reading from
+ * or writing to it fails. In the latter case, the callback is invoked from
+ * `write` or `poll`.
+ *
+ * @param link      The index of the link.
+ * @param frame     The frame, or NULL if the link was closed by the other side.
+ * @param context   The context passed to the constructor.
+ */
+typedef void (*tinylink_gateway_callback_t)(size_t link, const frame_t* frame, void* context);
+
+/**
+ * @brief Gateway that multiplexes many links over one epoll set.
+ *
+ * Every link is a non-blocking file descriptor, such as a serial port, pseudo
+ * terminal or socket. Bytes are read in blocks and fed to a decoder per link,
+ * without going through `Stream`. Frames written are encoded into a buffer
+ * per link, and written when the file descriptor is writable. Sockets are
+ * written without raising `SIGPIPE`, so a peer that disconnects only closes
+ * its link. For pipes, the application must ignore `SIGPIPE` itself.
+ *
+ * File descriptors are not closed by the gateway.
+ */
+class TinyLinkGateway {
+public:
+    /**
+     * @brief Construct a new TinyLinkGateway object.
+     *
+     * @param _links    The maximum number of links.
+     * @param _length   The length of the decoder buffer of every link.
+     * @param _callback The callback to invoke for every frame.
+     * @param _context  The context to pass to the callback.
+     */
+    TinyLinkGateway(size_t _links, size_t _length, tinylink_gateway_callback_t _callback, void* _context);
+
+    ~TinyLinkGateway();
+
+    TinyLinkGateway(const TinyLinkGateway&) = delete;
+    TinyLinkGateway& operator=(const TinyLinkGateway&) = delete;
+
+    /**
+     * @brief Add a link. The file descriptor is made non-blocking.
+     *
+     * @param fd        The file descriptor.
+     * @return int      The index of the link, or -1 if there is no room or
+     *                  the file descriptor cannot be added.
+     */
+    int add(int fd);
+
+    /**
+     * @brief Remove a link. Frames that are not yet written are dropped.
+     *
+     * @param link      The index of the link.
+     */
+    void remove(size_t link);
+
+    /**
+     * @brief Encode a frame and queue it for writing. As much as possible is
+     * written immediately.
+     *
+     * @param link      The index of the link.
+     * @param frame     The frame to write.
+     * @return true     If the frame was queued.
+     * @return false    If the link is closed, also by writing this frame, or
+     *                  there is no room.
+     */
+    bool write(size_t link, const frame_t* frame);
+
+    /**
+     * @brief Encode data and queue it for writing.
+     *
+     * @param link      The index of the link.
+     * @param flags     The flags to use.
+     * @param payload   The payload to write.
+     * @param length    The length of the payload.
+     * @return true     If the data was queued.
+     * @return false    If the link is closed, or there is no room.
+     */
+    bool write(size_t link, const uint16_t flags, const void* payload, const uint16_t length);
+
+    /**
+     * @brief Wait for links to become readable or writable, and handle them.
+     *
+     * @param timeout   The timeout in milliseconds, or -1 to wait forever.
+     * @return int      The number of frames received, or -1 on error.
+     */
+    int poll(int timeout);
+
+    /**
+     * @brief Wake up a thread that waits in `poll`. This can be called from
+     * any thread.
+     */
+    void wake();
+
+    /**
+     * @brief Return true if a link is open.
+     *
+     * @param link      The index of the link.
+     * @return true     If the link is open.
+     * @return false    If the link was removed or closed.
+     */
+    bool isOpen(size_t link) const;
+
+    /**
+     * @brief Return the number of bytes waiting to be written to a link.
+     *
+     * @param link      The index of the link.
+     * @return size_t   The number of bytes.
+     */
+    size_t getPending(size_t link) const;
+
+    /**
+     * @brief Return the epoll file descriptor, to integrate the gateway in
+     * another event loop.
+     *
+     * @return int      The file descriptor.
+     */
+    int getFd() const;
+private:
+    struct link_t {
+        TinyLinkGateway* gateway;
+        size_t index;
+
+        int fd;
+        bool socket;
+        bool open;
+        bool waiting;
+
+        TinyLinkDecoder* decoder;
+        uint8_t* buffer;
+
+        uint8_t* pending;
+        size_t pendingOffset;
+        size_t pendingLength;
+
+        size_t frames;
+    };
+
+    static void receive(const frame_t* frame, void* context);
+
+    void read(link_t* link);
+    void flush(link_t* link);
+    void close(link_t* link);
+    void hangup(link_t* link);
+    void watch(link_t* link, bool writable);
+
+    int epoll;
+    int wakeup;
+
+    link_t* links;
+    size_t count;
+    size_t length;
+
+    tinylink_gateway_callback_t callback;
+    void* context;
+
+    uint8_t block[TINYLINK_GATEWAY_READ_SIZE];
+};
+
+#endif
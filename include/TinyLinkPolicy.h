@@ -0,0 +1,233 @@
+#pragma once
+
+#include "TinyLinkProtocol.h"
+
+#include <string.h>
+
+// Maximum number of bytes in a run of the COBS policy.
+#define COBS_MAX_RUN    254
+
+// Results of decoding a byte of the header or body.
+typedef enum {
+    DECODE_SKIP = 0,
+    DECODE_BYTE,
+    DECODE_INVALID
+} tinylink_decode_e;
+
+/**
+ * @brief Framing policy that escapes `FLAG` and `ESCAPE` by prefixing them
+ * with `ESCAPE`.
+ *
+ * This is the default policy, and is compatible with other implementations of
+ * TinyLink. In the worst case, the encoded data is twice as large.
+ */
+class TinyLinkStuffingPolicy {
+public:
+    // State kept by the link while encoding a frame.
+    struct encoder_t {
+    };
+
+    TinyLinkStuffingPolicy() : unescaping(false) {}
+
+    /**
+     * @brief Return the maximum length of an encoded frame.
+     *
+     * @param length    The length of the payload.
+     * @return size_t   The maximum length, including the preamble.
+     */
+    static constexpr size_t maxEncodedLength(size_t length)
+    {
+        return LEN_PREAMBLE + 2 * (LEN_HEADER + length + LEN_CRC);
+    }
+
+    /**
+     * @brief Reset the decoder state, at the start of a frame.
+     */
+    void reset()
+    {
+        this->unescaping = false;
+    }
+
+    /**
+     * @brief Decode a byte of the header or body.
+     *
+     * @param byte      The received byte, replaced by the decoded byte.
+     * @return tinylink_decode_e    `DECODE_BYTE` if a decoded byte is
+     *                              available, `DECODE_SKIP` otherwise.
+     */
+    tinylink_decode_e decode(uint8_t* byte)
+    {
+        if (this->unescaping) {
+            this->unescaping = false;
+        }
+        else if (*byte == ESCAPE) {
+            this->unescaping = true;
+            return DECODE_SKIP;
+        }
+
+        return DECODE_BYTE;
+    }
+
+    /**
+     * @brief Decode the bytes at the start of a span that decode to
+     * themselves, as if passed to `decode` one by one.
+     *
+     * @param data      The received bytes.
+     * @param length    The number of bytes.
+     * @return size_t   The number of bytes decoded, up to the first escape.
+     */
+    size_t literal(const uint8_t* data, size_t length)
+    {
+        if (this->unescaping) {
+            return 0;
+        }
+
+        const uint8_t* escape = static_cast<const uint8_t*>(memchr(data, ESCAPE, length));
+
+        return escape != NULL ? escape - data : length;
+    }
+
+    /**
+     * @brief Return the last bytes passed to `decode`, most recent in the
+     * highest byte. This policy never returns `DECODE_INVALID`.
+     *
+     * @return uint32_t Always zero.
+     */
+    uint32_t getHistory() const
+    {
+        return 0;
+    }
+private:
+    bool unescaping;
+};
+
+/**
+ * @brief Framing policy based on Consistent Overhead Byte Stuffing.
+ *
+ * The header and body are split into runs of at most `COBS_MAX_RUN` bytes
+ * that do not contain `FLAG`. Every run is prefixed with its length plus one,
+ * XOR'ed with `FLAG`, and a `FLAG` is implied between runs shorter than the
+ * maximum. The encoded data therefore never contains `FLAG`, and grows by at
+ * most one byte per `COBS_MAX_RUN` bytes.
+ *
+ * This policy is not compatible with other implementations of TinyLink, so
+ * both ends of the link must use it.
+ */
+class TinyLinkCobsPolicy {
+public:
+    // State kept by the link while encoding a frame. The bytes of a run are
+    // held back until the run is complete, because its length comes first.
+    struct encoder_t {
+        encoder_t() : length(0), open(true) {}
+
+        uint8_t run[COBS_MAX_RUN];
+        uint8_t length;
+        bool open;
+    };
+
+    TinyLinkCobsPolicy() : remaining(0), code(0), history(0) {}
+
+    /**
+     * @brief Return the maximum length of an encoded frame.
+     *
+     * @param length    The length of the payload.
+     * @return size_t   The maximum length, including the preamble.
+     */
+    static constexpr size_t maxEncodedLength(size_t length)
+    {
+        return LEN_PREAMBLE + (LEN_HEADER + length + LEN_CRC) + (LEN_HEADER + length + LEN_CRC) / COBS_MAX_RUN + 1;
+    }
+
+    /**
+     * @brief Reset the decoder state, at the start of a frame.
+     */
+    void reset()
+    {
+        this->remaining = 0;
+        this->code = 0;
+    }
+
+    /**
+     * @brief Decode a byte of the header or body.
+     *
+     * @param byte      The received byte, replaced by the decoded byte.
+     * @return tinylink_decode_e    `DECODE_BYTE` if a decoded byte is
+     *                              available, `DECODE_SKIP` otherwise, or
+     *                              `DECODE_INVALID` if the byte is `FLAG`.
+     */
+    tinylink_decode_e decode(uint8_t* byte)
+    {
+        if (*byte == FLAG) {
+            return DECODE_INVALID;
+        }
+
+        this->history = (this->history >> 8) | (static_cast<uint32_t>(*byte) << 24);
+
+        if (this->remaining > 0) {
+            this->remaining--;
+            return DECODE_BYTE;
+        }
+
+        // Start of a run. The implied `FLAG` after the previous run is only
+        // returned now, because the frame may have ended with that run.
+        bool separator = this->code != 0 && this->code != COBS_MAX_RUN + 1;
+
+        this->code = *byte ^ FLAG;
+        this->remaining = this->code - 1;
+
+        if (separator) {
+            *byte = FLAG;
+            return DECODE_BYTE;
+        }
+
+        return DECODE_SKIP;
+    }
+
+    /**
+     * @brief Decode the bytes at the start of a span that decode to
+     * themselves, as if passed to `decode` one by one.
+     *
+     * @param data      The received bytes.
+     * @param length    The number of bytes.
+     * @return size_t   The number of bytes decoded, up to the end of the run
+     *                  or the first `FLAG`.
+     */
+    size_t literal(const uint8_t* data, size_t length)
+    {
+        if (length > this->remaining) {
+            length = this->remaining;
+        }
+
+        const uint8_t* flag = static_cast<const uint8_t*>(memchr(data, FLAG, length));
+
+        if (flag != NULL) {
+            length = flag - data;
+        }
+
+        // Only the last four bytes remain in the history.
+        for (size_t i = length > 4 ? length - 4 : 0; i < length; i++) {
+            this->history = (this->history >> 8) | (static_cast<uint32_t>(data[i]) << 24);
+        }
+
+        this->remaining -= static_cast<uint8_t>(length);
+
+        return length;
+    }
+
+    /**
+     * @brief Return the last bytes passed to `decode`, most recent in the
+     * highest byte. After `DECODE_INVALID`, these bytes may be the start of the
+     * preamble of the next frame.
+     *
+     * @return uint32_t The last bytes.
+     */
+    uint32_t getHistory() const
+    {
+        return this->history;
+    }
+private:
+    uint8_t remaining;
+    uint8_t code;
+
+    uint32_t history;
+};
@@ -0,0 +1,162 @@
+#pragma once
+
+#include "TinyLink.h"
+
+/**
+ * @brief Receive frames into a pool of slots.
+ *
+ * The payload of a frame returned by `TinyLink::readFrame` is overwritten by
+ * the next call. This class decodes frames directly into one of `SLOTS`
+ * slots instead. A slot stays valid until it is released, while frames
+ * continue to be received into the other slots. If all slots are in use, no
+ * data is read from the stream until a slot is released.
+ *
+ * @tparam SLOTS    The number of slots.
+ */
+template <uint8_t SLOTS>
+class TinyLinkPool {
+public:
+    /**
+     * @brief Construct a new TinyLinkPool object.
+     *
+     * The buffer is divided in `SLOTS` slots of equal length. Each slot holds
+     * the payload of one frame.
+     *
+     * @param _stream   The stream to use.
+     * @param _buffer   The buffer to use.
+     * @param _length   The length of the buffer.
+     */
+    TinyLinkPool(Stream& _stream, uint8_t* _buffer, size_t _length);
+
+    /**
+     * @brief Read a frame from the stream into a free slot.
+     *
+     * All bytes available are processed, like `TinyLink::pollFrame`.
+     *
+     * @param frame     The frame to read into.
+     * @param slot      The slot that holds the payload.
+     * @return true     If a frame was read.
+     * @return false    If no frame was read, or if no slot is free.
+     */
+    bool readFrame(frame_t* frame, uint8_t* slot);
+
+    /**
+     * @brief Release a slot, so it can be used for the next frame.
+     *
+     * @param slot      The slot to release.
+     */
+    void release(uint8_t slot);
+
+    /**
+     * @brief Return the number of free slots.
+     *
+     * @return uint8_t  The number of free slots.
+     */
+    uint8_t available() const;
+
+    /**
+     * @brief Return the underlying link, e.g. for writing frames.
+     *
+     * @return TinyLink& The underlying link.
+     */
+    TinyLink& getLink();
+private:
+    static uint8_t* selectSlot(uint16_t flags, uint16_t length, void* context);
+
+    // Only the header is decoded into this buffer.
+    uint8_t header[LEN_HEADER];
+
+    TinyLink tinylink;
+
+    uint8_t* buffer;
+    uint16_t slotLength;
+
+    bool used[SLOTS];
+    uint8_t pending;
+};
+
+template <uint8_t SLOTS>
+TinyLinkPool<SLOTS>::TinyLinkPool(Stream& _stream, uint8_t* _buffer, size_t _length) :
+    tinylink(_stream, header, sizeof(header)), buffer(_buffer)
+{
+    size_t slotLength = _length / SLOTS;
+
+    this->slotLength = slotLength < 0xFFFF ? slotLength : 0xFFFF;
+    this->pending = 0;
+
+    for (uint8_t i = 0; i < SLOTS; i++) {
+        this->used[i] = false;
+    }
+
+    this->tinylink.setMaxWriteLength(this->slotLength);
+    this->tinylink.setDestinationCallback(&TinyLinkPool<SLOTS>::selectSlot, this);
+}
+
+template <uint8_t SLOTS>
+uint8_t* TinyLinkPool<SLOTS>::selectSlot(uint16_t flags, uint16_t length, void* context)
+{
+    TinyLinkPool<SLOTS>* pool = static_cast<TinyLinkPool<SLOTS>*>(context);
+
+    (void) flags;
+
+    if (length > pool->slotLength) {
+        return NULL;
+    }
+
+    for (uint8_t i = 0; i < SLOTS; i++) {
+        if (!pool->used[i]) {
+            pool->pending = i;
+
+            return &pool->buffer[i * pool->slotLength];
+        }
+    }
+
+    return NULL;
+}
+
+template <uint8_t SLOTS>
+bool TinyLinkPool<SLOTS>::readFrame(frame_t* frame, uint8_t* slot)
+{
+    // A frame in progress always has a slot, because the slot is only marked
+    // as used once the frame is complete.
+    if (this->available() == 0) {
+        return false;
+    }
+
+    if (!this->tinylink.pollFrame(frame)) {
+        return false;
+    }
+
+    this->used[this->pending] = true;
+    *slot = this->pending;
+
+    return true;
+}
+
+template <uint8_t SLOTS>
+void TinyLinkPool<SLOTS>::release(uint8_t slot)
+{
+    if (slot < SLOTS) {
+        this->used[slot] = false;
+    }
+}
+
+template <uint8_t SLOTS>
+uint8_t TinyLinkPool<SLOTS>::available() const
+{
+    uint8_t count = 0;
+
+    for (uint8_t i = 0; i < SLOTS; i++) {
+        if (!this->used[i]) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+template <uint8_t SLOTS>
+TinyLink& TinyLinkPool<SLOTS>::getLink()
+{
+    return this->tinylink;
+}
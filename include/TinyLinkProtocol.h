@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// This can be anything, and is used to synchronize a frame.
+#define PREAMBLE        0xAA55AA55
+
+// The escape character is used for byte-stuffing of the header and body.
+#define FLAG            0xAA
+#define ESCAPE          0x1B
+
+// Do not change the values below!
+#define LEN_PREAMBLE    4
+
+#define LEN_FLAGS       2
+#define LEN_LENGTH      2
+#define LEN_XOR         1
+#define LEN_HEADER      (LEN_FLAGS + LEN_LENGTH + LEN_XOR)
+
+#define LEN_CRC         4
+#define LEN_BODY        LEN_CRC
+
+// Reserved flag that marks a frame that carries aggregated messages.
+#define FLAGS_AGGREGATE 0x8000
+
+// Protocol states.
+typedef enum {
+    WAITING_FOR_PREAMBLE = 1,
+    WAITING_FOR_HEADER,
+    WAITING_FOR_BODY
+} tinylink_state_e;
+
+struct frame_t {
+    uint16_t length;
+    uint16_t flags;
+    const uint8_t* payload;
+};
+
+// A segment of a payload that is split across multiple buffers.
+struct segment_t {
+    uint16_t length;
+    const uint8_t* data;
+};
+
+// Callback that returns a monotonic time, for example `millis()`.
+typedef uint32_t (*tinylink_clock_callback_t)(void);
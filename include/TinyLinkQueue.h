@@ -0,0 +1,304 @@
+#pragma once
+
+#include <Stream.h>
+
+#include "TinyLinkEncoder.h"
+#include "TinyLinkRing.h"
+
+// Every frame in the queue is prefixed with its encoded length.
+#define LEN_QUEUE_PREFIX 4
+
+template <size_t SIZE, uint8_t LEVELS>
+class TinyLinkScheduler;
+
+/**
+ * @brief Queue for transmitting frames without blocking.
+ *
+ * Frames are encoded into a ring of `SIZE` bytes when enqueued. Calling
+ * `pump` regularly moves as many bytes to the stream as it can accept without
+ * blocking, as reported by `Stream::availableForWrite`. Frames that do not fit
+ * in the queue are dropped.
+ *
+ * @tparam SIZE     The size of the queue in bytes, which must be a power of
+ *                  two. Every frame takes its encoded length plus four bytes.
+ */
+template <size_t SIZE>
+class TinyLinkQueue {
+public:
+    /**
+     * @brief Construct a new TinyLinkQueue object.
+     *
+     * @param _stream   The stream to use.
+     */
+    TinyLinkQueue(Stream& _stream);
+
+    /**
+     * @brief Encode a frame and add it to the queue.
+     *
+     * @param frame     The frame to enqueue.
+     * @return true     If the frame was enqueued.
+     * @return false    If the frame does not fit, and was dropped.
+     */
+    bool enqueue(const frame_t* frame);
+
+    /**
+     * @brief Encode data and add it to the queue.
+     *
+     * @param flags     The flags to use.
+     * @param payload   The payload to enqueue.
+     * @param length    The length of the payload.
+     * @return true     If the data was enqueued.
+     * @return false    If the data does not fit, and was dropped.
+     */
+    bool enqueue(const uint16_t flags, const void* payload, const uint16_t length);
+
+    /**
+     * @brief Move bytes to the stream, without blocking.
+     *
+     * @return size_t   The number of bytes written to the stream.
+     */
+    size_t pump();
+
+    /**
+     * @brief Move bytes to the stream, without blocking, up to a limit.
+     *
+     * @param limit     The maximum number of bytes to write.
+     * @param boundary  Stop at the end of the frame being written.
+     * @return size_t   The number of bytes written to the stream.
+     */
+    size_t pump(size_t limit, bool boundary);
+
+    /**
+     * @brief Return the number of frames in the queue, including the frame
+     * being written.
+     *
+     * @return uint32_t The number of frames.
+     */
+    uint32_t getDepth() const;
+
+    /**
+     * @brief Return the number of bytes in the queue.
+     *
+     * @return size_t   The number of bytes, including the length prefixes.
+     */
+    size_t getPending() const;
+
+    /**
+     * @brief Return the number of frames dropped because the queue was full.
+     *
+     * @return uint32_t The number of frames dropped.
+     */
+    uint32_t getDrops() const;
+
+    /**
+     * @brief Return true if a frame has been partially written.
+     *
+     * @return true     If a frame is being written.
+     * @return false    If the next byte written starts a new frame.
+     */
+    bool isWriting() const;
+private:
+    template <size_t, uint8_t>
+    friend class TinyLinkScheduler;
+
+    TinyLinkQueue();
+
+    size_t pump(Stream& stream, size_t space, size_t limit, bool boundary);
+
+    // Bytes of a frame that are encoded into the ring, but not committed yet.
+    struct staging_t {
+        TinyLinkRing<SIZE>* ring;
+        size_t length;
+    };
+
+    static void stageRing(const uint8_t* data, size_t length, void* context);
+
+    Stream* stream;
+
+    TinyLinkRing<SIZE> ring;
+
+    uint32_t remaining;
+
+    uint32_t enqueued;
+    uint32_t written;
+    uint32_t drops;
+};
+
+template <size_t SIZE>
+TinyLinkQueue<SIZE>::TinyLinkQueue(Stream& _stream) : stream(&_stream)
+{
+    this->remaining = 0;
+
+    this->enqueued = 0;
+    this->written = 0;
+    this->drops = 0;
+}
+
+template <size_t SIZE>
+TinyLinkQueue<SIZE>::TinyLinkQueue() : stream(NULL)
+{
+    this->remaining = 0;
+
+    this->enqueued = 0;
+    this->written = 0;
+    this->drops = 0;
+}
+
+template <size_t SIZE>
+void TinyLinkQueue<SIZE>::stageRing(const uint8_t* data, size_t length, void* context)
+{
+    staging_t* staging = static_cast<staging_t*>(context);
+
+    staging->ring->stage(staging->length, data, length);
+    staging->length += length;
+}
+
+template <size_t SIZE>
+bool TinyLinkQueue<SIZE>::enqueue(const frame_t* frame)
+{
+    size_t space = SIZE - this->ring.available();
+
+    // A frame that fits even if every byte needs escaping is encoded straight
+    // into the ring, and its length is known afterwards. Only when the queue
+    // is nearly full is the exact length computed first, in a separate pass.
+    if (TinyLinkEncoder::maxEncodedLength(frame->length) + LEN_QUEUE_PREFIX > space &&
+        TinyLinkEncoder::encodedLength(frame) + LEN_QUEUE_PREFIX > space) {
+        this->drops++;
+        return false;
+    }
+
+    // The prefix is staged last, so the consumer never sees a partial frame.
+    staging_t staging = {&this->ring, LEN_QUEUE_PREFIX};
+
+    TinyLinkEncoder::encode(frame, &TinyLinkQueue<SIZE>::stageRing, &staging);
+
+    size_t length = staging.length - LEN_QUEUE_PREFIX;
+
+    const uint8_t prefix[LEN_QUEUE_PREFIX] = {
+        static_cast<uint8_t>(length >> 0),
+        static_cast<uint8_t>(length >> 8),
+        static_cast<uint8_t>(length >> 16),
+        static_cast<uint8_t>(length >> 24)
+    };
+
+    this->ring.stage(0, prefix, sizeof(prefix));
+    this->ring.commit(staging.length);
+
+    this->enqueued++;
+
+    return true;
+}
+
+template <size_t SIZE>
+bool TinyLinkQueue<SIZE>::enqueue(const uint16_t flags, const void* payload, const uint16_t length)
+{
+    frame_t frame;
+
+    frame.length = length;
+    frame.flags = flags;
+    frame.payload = static_cast<const uint8_t*>(payload);
+
+    return this->enqueue(&frame);
+}
+
+template <size_t SIZE>
+size_t TinyLinkQueue<SIZE>::pump()
+{
+    return this->pump(static_cast<size_t>(-1), false);
+}
+
+template <size_t SIZE>
+size_t TinyLinkQueue<SIZE>::pump(size_t limit, bool boundary)
+{
+    int space = this->stream->availableForWrite();
+
+    if (space <= 0) {
+        return 0;
+    }
+
+    return this->pump(*this->stream, space, limit, boundary);
+}
+
+template <size_t SIZE>
+size_t TinyLinkQueue<SIZE>::pump(Stream& stream, size_t space, size_t limit, bool boundary)
+{
+    size_t count = 0;
+
+    if (space < limit) {
+        limit = space;
+    }
+
+    while (count < limit) {
+        // Start the next frame, by reading its length.
+        if (this->remaining == 0) {
+            if (boundary && count > 0) {
+                break;
+            }
+
+            if (this->ring.available() < LEN_QUEUE_PREFIX) {
+                break;
+            }
+
+            uint8_t prefix[LEN_QUEUE_PREFIX];
+
+            this->ring.read(prefix, sizeof(prefix));
+
+            this->remaining = static_cast<uint32_t>(prefix[0]) << 0 |
+                              static_cast<uint32_t>(prefix[1]) << 8 |
+                              static_cast<uint32_t>(prefix[2]) << 16 |
+                              static_cast<uint32_t>(prefix[3]) << 24;
+        }
+
+        // Write (part of) the frame, without copying.
+        size_t length;
+        const uint8_t* data = this->ring.peek(&length);
+
+        if (length > this->remaining) {
+            length = this->remaining;
+        }
+
+        if (length > limit - count) {
+            length = limit - count;
+        }
+
+        size_t written = stream.write(data, length);
+
+        this->ring.consume(written);
+        this->remaining -= written;
+        count += written;
+
+        if (this->remaining == 0) {
+            this->written++;
+        }
+
+        if (written < length) {
+            break;
+        }
+    }
+
+    return count;
+}
+
+template <size_t SIZE>
+uint32_t TinyLinkQueue<SIZE>::getDepth() const
+{
+    return this->enqueued - this->written;
+}
+
+template <size_t SIZE>
+size_t TinyLinkQueue<SIZE>::getPending() const
+{
+    return this->ring.available();
+}
+
+template <size_t SIZE>
+uint32_t TinyLinkQueue<SIZE>::getDrops() const
+{
+    return this->drops;
+}
+
+template <size_t SIZE>
+bool TinyLinkQueue<SIZE>::isWriting() const
+{
+    return this->remaining > 0;
+}
@@ -0,0 +1,269 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__AVR__)
+    #include <util/atomic.h>
+#endif
+
+/**
+ * @brief Lock-free single-producer, single-consumer byte ring.
+ *
+ * The producer (e.g. an UART receive interrupt) pushes bytes into the ring,
+ * while the consumer (e.g. the main loop) drains them in batches, for example
+ * into a `TinyLinkDecoder`. Bytes that do not fit are dropped and counted.
+ *
+ * The head is only written by the producer, and the tail only by the
+ * consumer. Both indices run freely and are masked on access, so all `SIZE`
+ * bytes can be used.
+ *
+ * @tparam SIZE     The size of the ring, which must be a power of two.
+ */
+template <size_t SIZE>
+class TinyLinkRing {
+    static_assert(SIZE > 0 && (SIZE & (SIZE - 1)) == 0, "SIZE must be a power of two.");
+public:
+    TinyLinkRing();
+
+    /**
+     * @brief Push a byte into the ring (producer).
+     *
+     * This method can be called from an interrupt handler.
+     *
+     * @param byte      The byte to push.
+     * @return true     If the byte was pushed.
+     * @return false    If the ring is full. The byte is dropped.
+     */
+    bool push(uint8_t byte);
+
+    /**
+     * @brief Push multiple bytes into the ring (producer).
+     *
+     * @param data      The bytes to push.
+     * @param length    The number of bytes to push.
+     * @return size_t   The number of bytes pushed. The others are dropped.
+     */
+    size_t write(const uint8_t* data, size_t length);
+
+    /**
+     * @brief Copy bytes into the ring past the head, without making them
+     * available yet (producer).
+     *
+     * The caller must make sure that there is space. Call `commit` to make the
+     * bytes available to the consumer.
+     *
+     * @param offset    The offset from the head.
+     * @param data      The bytes to copy.
+     * @param length    The number of bytes to copy.
+     */
+    void stage(size_t offset, const uint8_t* data, size_t length);
+
+    /**
+     * @brief Make bytes copied using `stage` available (producer).
+     *
+     * @param length    The number of bytes to make available.
+     */
+    void commit(size_t length);
+
+    /**
+     * @brief Read bytes from the ring (consumer).
+     *
+     * @param data      The buffer to read into.
+     * @param length    The length of the buffer.
+     * @return size_t   The number of bytes read.
+     */
+    size_t read(uint8_t* data, size_t length);
+
+    /**
+     * @brief Return the longest contiguous span of bytes that can be read,
+     * without copying (consumer).
+     *
+     * Call `consume` when done with (part of) the span.
+     *
+     * @param length    The length of the span.
+     * @return const uint8_t* The start of the span.
+     */
+    const uint8_t* peek(size_t* length) const;
+
+    /**
+     * @brief Remove bytes that were read using `peek` (consumer).
+     *
+     * @param length    The number of bytes to remove.
+     */
+    void consume(size_t length);
+
+    /**
+     * @brief Return the number of bytes that can be read.
+     *
+     * @return size_t   The number of bytes.
+     */
+    size_t available() const;
+
+    /**
+     * @brief Return the number of bytes dropped because the ring was full.
+     *
+     * @return uint32_t The number of bytes dropped.
+     */
+    uint32_t getOverflows() const;
+private:
+    template <typename T>
+    static T load(const T* value);
+
+    template <typename T>
+    static void store(T* value, T data);
+
+    uint8_t buffer[SIZE];
+
+    size_t head;
+    size_t tail;
+
+    uint32_t overflows;
+};
+
+template <size_t SIZE>
+template <typename T>
+T TinyLinkRing<SIZE>::load(const T* value)
+{
+#if defined(__AVR__)
+    // Multi-byte values are not read atomically on AVR.
+    T result;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        result = *reinterpret_cast<const volatile T*>(value);
+    }
+
+    return result;
+#else
+    return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+#endif
+}
+
+template <size_t SIZE>
+template <typename T>
+void TinyLinkRing<SIZE>::store(T* value, T data)
+{
+#if defined(__AVR__)
+    // Multi-byte values are not written atomically on AVR.
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        *reinterpret_cast<volatile T*>(value) = data;
+    }
+#else
+    __atomic_store_n(value, data, __ATOMIC_RELEASE);
+#endif
+}
+
+template <size_t SIZE>
+TinyLinkRing<SIZE>::TinyLinkRing()
+{
+    this->head = 0;
+    this->tail = 0;
+    this->overflows = 0;
+}
+
+template <size_t SIZE>
+bool TinyLinkRing<SIZE>::push(uint8_t byte)
+{
+    size_t head = this->head;
+
+    if (head - load(&this->tail) == SIZE) {
+        store(&this->overflows, this->overflows + 1);
+        return false;
+    }
+
+    this->buffer[head & (SIZE - 1)] = byte;
+    store(&this->head, head + 1);
+
+    return true;
+}
+
+template <size_t SIZE>
+size_t TinyLinkRing<SIZE>::write(const uint8_t* data, size_t length)
+{
+    size_t head = this->head;
+    size_t space = SIZE - (head - load(&this->tail));
+
+    if (length > space) {
+        store(&this->overflows, static_cast<uint32_t>(this->overflows + (length - space)));
+        length = space;
+    }
+
+    this->stage(0, data, length);
+    this->commit(length);
+
+    return length;
+}
+
+template <size_t SIZE>
+void TinyLinkRing<SIZE>::stage(size_t offset, const uint8_t* data, size_t length)
+{
+    // Copy in at most two parts, if the data wraps around.
+    offset = (this->head + offset) & (SIZE - 1);
+    size_t first = (SIZE - offset) < length ? (SIZE - offset) : length;
+
+    memcpy(&this->buffer[offset], data, first);
+    memcpy(&this->buffer[0], data + first, length - first);
+}
+
+template <size_t SIZE>
+void TinyLinkRing<SIZE>::commit(size_t length)
+{
+    store(&this->head, this->head + length);
+}
+
+template <size_t SIZE>
+size_t TinyLinkRing<SIZE>::read(uint8_t* data, size_t length)
+{
+    size_t count = 0;
+
+    while (count < length) {
+        size_t span;
+        const uint8_t* source = this->peek(&span);
+
+        if (span == 0) {
+            break;
+        }
+
+        if (span > length - count) {
+            span = length - count;
+        }
+
+        memcpy(data + count, source, span);
+        this->consume(span);
+
+        count += span;
+    }
+
+    return count;
+}
+
+template <size_t SIZE>
+const uint8_t* TinyLinkRing<SIZE>::peek(size_t* length) const
+{
+    size_t tail = this->tail;
+    size_t count = load(&this->head) - tail;
+    size_t offset = tail & (SIZE - 1);
+
+    *length = (SIZE - offset) < count ? (SIZE - offset) : count;
+
+    return &this->buffer[offset];
+}
+
+template <size_t SIZE>
+void TinyLinkRing<SIZE>::consume(size_t length)
+{
+    store(&this->tail, this->tail + length);
+}
+
+template <size_t SIZE>
+size_t TinyLinkRing<SIZE>::available() const
+{
+    return load(&this->head) - load(&this->tail);
+}
+
+template <size_t SIZE>
+uint32_t TinyLinkRing<SIZE>::getOverflows() const
+{
+    return load(&this->overflows);
+}
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <Stream.h>
+
+#include "TinyLinkQueue.h"
+
+/**
+ * @brief Callback to determine the priority level of a frame, given its flags.
+ * Level zero is the highest priority.
+ */
+typedef uint8_t (*tinylink_priority_callback_t)(uint16_t flags, void* context);
+
+/**
+ * @brief Transmit scheduler with multiple priority levels.
+ *
+ * Every level has its own `TinyLinkQueue`. Frames are never interleaved
+ * byte-wise: once a frame is started, it is written completely before the
+ * next frame is selected from the highest priority level that is not empty.
+ * A high priority frame therefore waits at most for one frame of a lower
+ * priority level that is being written.
+ *
+ * @tparam SIZE     The size of each queue in bytes, which must be a power of
+ *                  two.
+ * @tparam LEVELS   The number of priority levels.
+ */
+template <size_t SIZE, uint8_t LEVELS>
+class TinyLinkScheduler {
+public:
+    /**
+     * @brief Construct a new TinyLinkScheduler object.
+     *
+     * @param _stream   The stream to use.
+     */
+    TinyLinkScheduler(Stream& _stream);
+
+    /**
+     * @brief Set the callback that determines the priority level of a frame
+     * from its flags. Without callback, frames go to the lowest priority
+     * level.
+     *
+     * @param callback  The callback, or NULL.
+     * @param context   The context passed to the callback.
+     */
+    void setPriorityCallback(tinylink_priority_callback_t callback, void* context);
+
+    /**
+     * @brief Enqueue a frame at the level determined by its flags.
+     *
+     * @param frame     The frame to enqueue.
+     * @return true     If the frame was enqueued.
+     * @return false    If the frame does not fit, and was dropped.
+     */
+    bool enqueue(const frame_t* frame);
+
+    /**
+     * @brief Enqueue a frame at an explicit priority level.
+     *
+     * @param frame     The frame to enqueue.
+     * @param level     The priority level, where zero is the highest.
+     * @return true     If the frame was enqueued.
+     * @return false    If the frame does not fit, and was dropped.
+     */
+    bool enqueue(const frame_t* frame, uint8_t level);
+
+    /**
+     * @brief Move bytes to the stream, without blocking.
+     *
+     * @return size_t   The number of bytes written to the stream.
+     */
+    size_t pump();
+
+    /**
+     * @brief Return the number of frames at a priority level.
+     *
+     * @param level     The priority level.
+     * @return uint32_t The number of frames.
+     */
+    uint32_t getDepth(uint8_t level) const;
+
+    /**
+     * @brief Return the number of frames dropped at a priority level.
+     *
+     * @param level     The priority level.
+     * @return uint32_t The number of frames dropped.
+     */
+    uint32_t getDrops(uint8_t level) const;
+private:
+    Stream& stream;
+
+    TinyLinkQueue<SIZE> queues[LEVELS];
+
+    uint8_t current;
+
+    tinylink_priority_callback_t priorityCallback;
+    void* priorityContext;
+};
+
+template <size_t SIZE, uint8_t LEVELS>
+TinyLinkScheduler<SIZE, LEVELS>::TinyLinkScheduler(Stream& _stream) : stream(_stream)
+{
+    this->current = 0;
+
+    this->priorityCallback = NULL;
+    this->priorityContext = NULL;
+}
+
+template <size_t SIZE, uint8_t LEVELS>
+void TinyLinkScheduler<SIZE, LEVELS>::setPriorityCallback(tinylink_priority_callback_t callback, void* context)
+{
+    this->priorityCallback = callback;
+    this->priorityContext = context;
+}
+
+template <size_t SIZE, uint8_t LEVELS>
+bool TinyLinkScheduler<SIZE, LEVELS>::enqueue(const frame_t* frame)
+{
+    uint8_t level = LEVELS - 1;
+
+    if (this->priorityCallback) {
+        level = this->priorityCallback(frame->flags, this->priorityContext);
+    }
+
+    return this->enqueue(frame, level);
+}
+
+template <size_t SIZE, uint8_t LEVELS>
+bool TinyLinkScheduler<SIZE, LEVELS>::enqueue(const frame_t* frame, uint8_t level)
+{
+    if (level >= LEVELS) {
+        level = LEVELS - 1;
+    }
+
+    return this->queues[level].enqueue(frame);
+}
+
+template <size_t SIZE, uint8_t LEVELS>
+size_t TinyLinkScheduler<SIZE, LEVELS>::pump()
+{
+    int space = this->stream.availableForWrite();
+    size_t count = 0;
+
+    if (space <= 0) {
+        return 0;
+    }
+
+    while (count < static_cast<size_t>(space)) {
+        // Select the next level only at a frame boundary.
+        if (!this->queues[this->current].isWriting()) {
+            uint8_t level = 0;
+
+            while (level < LEVELS && this->queues[level].getPending() == 0) {
+                level++;
+            }
+
+            if (level == LEVELS) {
+                break;
+            }
+
+            this->current = level;
+        }
+
+        size_t written = this->queues[this->current].pump(this->stream, space - count, space - count, true);
+
+        if (written == 0) {
+            break;
+        }
+
+        count += written;
+    }
+
+    return count;
+}
+
+template <size_t SIZE, uint8_t LEVELS>
+uint32_t TinyLinkScheduler<SIZE, LEVELS>::getDepth(uint8_t level) const
+{
+    return this->queues[level].getDepth();
+}
+
+template <size_t SIZE, uint8_t LEVELS>
+uint32_t TinyLinkScheduler<SIZE, LEVELS>::getDrops(uint8_t level) const
+{
+    return this->queues[level].getDrops();
+}
@@ -0,0 +1,199 @@
+#pragma once
+
+#include "TinyLinkGateway.h"
+
+#ifdef TINYLINK_HAS_GATEWAY
+
+#include <atomic>
+#include <thread>
+
+/**
+ * @brief Gateway that shards links across worker threads.
+ *
+ * Every worker thread runs its own `TinyLinkGateway`, so the decoders and
+ * buffers of a link are only touched by one thread. Received frames are
+ * copied into a bounded, lock-free single-producer single-consumer queue per
+ * worker thread, and the consumer thread reads the queues in turn.
+ *
+ * When the queue of a worker thread is full, it stops reading from its links
+ * and sleeps until the consumer thread frees a slot. The flow control of the
+ * file descriptors then slows down the other side, so no frames are dropped.
+ *
+ * Frames written by the consumer thread are passed to the worker thread of
+ * the link through a second queue, and written by that thread. When the other
+ * side of a link is gone, writing closes only that link, which is reported by
+ * `read` like a close found by reading.
+ */
+class TinyLinkShardedGateway {
+public:
+    /**
+     * @brief Construct a new TinyLinkShardedGateway object.
+     *
+     * @param _threads  The number of worker threads.
+     * @param _links    The maximum number of links per worker thread.
+     * @param _length   The length of the decoder buffer of every link, which
+     *                  also limits the payload of frames in the queue.
+     * @param _slots    The number of frames in the queue of every worker
+     *                  thread, which is rounded up to a power of two.
+     */
+    TinyLinkShardedGateway(size_t _threads, size_t _links, size_t _length, size_t _slots);
+
+    ~TinyLinkShardedGateway();
+
+    TinyLinkShardedGateway(const TinyLinkShardedGateway&) = delete;
+    TinyLinkShardedGateway& operator=(const TinyLinkShardedGateway&) = delete;
+
+    /**
+     * @brief Add a link to the worker thread with the fewest links. Links can
+     * only be added before `start` is called.
+     *
+     * @param fd        The file descriptor.
+     * @return int      The index of the link, or -1 if there is no room.
+     */
+    int add(int fd);
+
+    /**
+     * @brief Start the worker threads, pinning each to a CPU.
+     *
+     * @return true     If the threads were started.
+     * @return false    If the threads were already started.
+     */
+    bool start();
+
+    /**
+     * @brief Stop the worker threads, and wait for them to finish.
+     */
+    void stop();
+
+    /**
+     * @brief Read the next frame from the queues, without blocking. This must
+     * be called from one consumer thread only.
+     *
+     * The payload remains valid until the next call. A frame without payload
+     * (NULL) means the link was closed by the other side.
+     *
+     * @param link      Set to the index of the link.
+     * @param frame     The frame to read into.
+     * @return true     If a frame was read.
+     * @return false    If the queues are empty.
+     */
+    bool read(size_t* link, frame_t* frame);
+
+    /**
+     * @brief Queue a frame for writing by the worker thread of a link. This
+     * must be called from the consumer thread only.
+     *
+     * The frame is written when the worker thread wakes up, which is
+     * immediately if it is running. When the write buffer of the link is
+     * full, the frame waits in the queue until there is room, so frames that
+     * follow it are not accepted once the queue is full.
+     *
+     * @param link      The index of the link.
+     * @param frame     The frame to write.
+     * @return true     If the frame was queued.
+     * @return false    If the link is invalid, the payload is longer than the
+     *                  decoder buffer, or the queue is full.
+     */
+    bool write(size_t link, const frame_t* frame);
+
+    /**
+     * @brief Queue data for writing by the worker thread of a link.
+     *
+     * @param link      The index of the link.
+     * @param flags     The flags to use.
+     * @param payload   The payload to write.
+     * @param length    The length of the payload.
+     * @return true     If the data was queued.
+     * @return false    If the link is invalid, the payload is longer than the
+     *                  decoder buffer, or the queue is full.
+     */
+    bool write(size_t link, const uint16_t flags, const void* payload, const uint16_t length);
+
+    /**
+     * @brief Return the number of frames dropped because the gateway was
+     * stopped while a worker thread was waiting for room in its queue.
+     *
+     * @return uint32_t The number of frames dropped.
+     */
+    uint32_t getDrops() const;
+
+    /**
+     * @brief Return the number of queued frames that were not written,
+     * because the link was closed or the frame does not fit in the write
+     * buffer of the link.
+     *
+     * @return uint32_t The number of frames dropped.
+     */
+    uint32_t getWriteDrops() const;
+private:
+    struct slot_t {
+        size_t link;
+        uint16_t flags;
+        uint16_t length;
+        bool closed;
+        uint8_t* payload;
+    };
+
+    // The producer only writes `head`, and the consumer only writes `tail`,
+    // so they are padded to separate cache lines. Shards are allocated with
+    // `new[]`, which does not guarantee extended alignment before C++17.
+    struct ring_t {
+        slot_t* slots;
+        size_t mask;
+        uint8_t* storage;
+
+        uint8_t padding1[64];
+        std::atomic<size_t> head;
+        uint8_t padding2[64 - sizeof(std::atomic<size_t>)];
+        std::atomic<size_t> tail;
+        uint8_t padding3[64 - sizeof(std::atomic<size_t>)];
+    };
+
+    struct shard_t {
+        TinyLinkShardedGateway* owner;
+        size_t index;
+
+        TinyLinkGateway* gateway;
+        size_t links;
+
+        ring_t received;
+        ring_t commands;
+
+        // Signalled by the consumer thread when it frees a slot of `received`
+        // while the worker thread waits for one.
+        int space;
+        std::atomic<bool> waiting;
+
+        std::thread thread;
+        std::atomic<uint32_t> drops;
+        std::atomic<uint32_t> writeDrops;
+    };
+
+    static void receive(size_t link, const frame_t* frame, void* context);
+
+    static void create(ring_t* ring, size_t slots, size_t length);
+    static void destroy(ring_t* ring);
+    static slot_t* claim(ring_t* ring);
+    static void publish(ring_t* ring);
+    static slot_t* peek(ring_t* ring);
+    static void release(ring_t* ring);
+
+    static void wait(shard_t* shard);
+    static void notify(shard_t* shard);
+
+    void run(shard_t* shard);
+    void execute(shard_t* shard);
+
+    shard_t* shards;
+    size_t threads;
+    size_t links;
+    size_t length;
+
+    size_t current;
+    size_t next;
+    bool holding;
+
+    std::atomic<bool> running;
+};
+
+#endif
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+
+// Count what happens on the wire. Disabled by default, in which case the
+// counters are not compiled in at all.
+#ifndef TINYLINK_STATS
+#define TINYLINK_STATS 0
+#endif
+
+// Invoke a callback around encoding and decoding frames, for example to read
+// a cycle counter. Disabled by default.
+#ifndef TINYLINK_TRACE
+#define TINYLINK_TRACE 0
+#endif
+
+// Statistics of a link. Counters wrap around on overflow.
+struct tinylink_stats_t {
+    // Valid frames received, and bytes received.
+    uint32_t framesIn;
+    uint32_t bytesIn;
+
+    // Frames written, and bytes written including all overhead.
+    uint32_t framesOut;
+    uint32_t bytesOut;
+
+    // Bytes added to the header, payload and CRC by the framing policy.
+    uint32_t escapesOut;
+
+    // Bytes skipped while waiting for a preamble, counted once they can no
+    // longer be part of one. Bytes of rejected frames that are scanned again
+    // are counted when they are skipped again.
+    uint32_t huntSkipped;
+
+    // Frames rejected because of the header checksum, because the payload
+    // does not fit, or because of the CRC.
+    uint32_t headerRejects;
+    uint32_t lengthRejects;
+    uint32_t crcFailures;
+
+    // Preambles found in the bytes of rejected frames.
+    uint32_t resyncs;
+};
+
+// Events of the trace callback.
+typedef enum {
+    TRACE_ENCODE_BEGIN = 1,
+    TRACE_ENCODE_END,
+    TRACE_DECODE_BEGIN,
+    TRACE_DECODE_END
+} tinylink_trace_e;
+
+/**
+ * @brief Callback invoked around encoding and decoding frames.
+ *
+ * Encoding begins when the preamble is written, and ends when the frame is
+ * finished or aborted. Decoding begins when a preamble is found, and ends when
+ * the CRC is compared, or when the frame is rejected or aborted before that, so
+ * every begin is followed by an end.
+ *
+ * @param event     The event.
+ * @param context   The context passed to `setTraceCallback`.
+ */
+typedef void (*tinylink_trace_callback_t)(tinylink_trace_e event, void* context);
@@ -1,5 +1,33 @@
 #include "Crc.h"
 
+#if CRC32_BACKEND == CRC32_BACKEND_TABLE || CRC32_BACKEND == CRC32_BACKEND_SLICING8
+    #if defined(__AVR__)
+        #include <avr/pgmspace.h>
+
+        #define CRC32_TABLE_ATTR            PROGMEM
+        #define CRC32_TABLE_READ(entry)     pgm_read_dword(&(entry))
+    #else
+        #define CRC32_TABLE_ATTR
+        #define CRC32_TABLE_READ(entry)     (entry)
+    #endif
+
+    #if CRC32_BACKEND == CRC32_BACKEND_SLICING8
+        #define CRC32_SLICES 8
+    #else
+        #define CRC32_SLICES 1
+    #endif
+#elif CRC32_BACKEND == CRC32_BACKEND_HARDWARE
+    #if defined(__ARM_FEATURE_CRC32)
+        #include <arm_acle.h>
+    #elif defined(ESP_PLATFORM)
+        #include <esp_rom_crc.h>
+    #else
+        #error "No hardware CRC32 support for this platform."
+    #endif
+#elif CRC32_BACKEND != CRC32_BACKEND_BITWISE
+    #error "Unknown CRC32 backend."
+#endif
+
 static void CRC32Value(uint32_t &CRC, uint8_t c) {
     uint32_t temp = (CRC >> 8) & 0x00FFFFFFL;
     uint32_t crc = (static_cast<int>(CRC) ^ c) & 0xFF;
@@ -17,6 +45,60 @@ static void CRC32Value(uint32_t &CRC, uint8_t c) {
     CRC = temp ^ crc;
 }
 
+#if defined(CRC32_SLICES)
+// The tables are generated at compile time. The constexpr functions below are
+// restricted to a single return statement, so they work with C++11 compilers
+// (e.g. avr-gcc) too.
+static constexpr uint32_t CRC32Bits(uint32_t crc, uint8_t bits) {
+    return bits == 0 ? crc : CRC32Bits((crc & 1) ? (crc >> 1) ^ CRC32_POLYNOMIAL : (crc >> 1), bits - 1);
+}
+
+static constexpr uint32_t CRC32Slice(uint32_t crc) {
+    return (crc >> 8) ^ CRC32Bits(crc & 0xFF, 8);
+}
+
+static constexpr uint32_t CRC32Entry(uint32_t slice, uint32_t index) {
+    return slice == 0 ? CRC32Bits(index, 8) : CRC32Slice(CRC32Entry(slice - 1, index));
+}
+
+#define CRC32_ENTRIES_4(s, i)   CRC32Entry(s, i), CRC32Entry(s, i + 1), CRC32Entry(s, i + 2), CRC32Entry(s, i + 3)
+#define CRC32_ENTRIES_16(s, i)  CRC32_ENTRIES_4(s, i), CRC32_ENTRIES_4(s, i + 4), \
+                                CRC32_ENTRIES_4(s, i + 8), CRC32_ENTRIES_4(s, i + 12)
+#define CRC32_ENTRIES_64(s, i)  CRC32_ENTRIES_16(s, i), CRC32_ENTRIES_16(s, i + 16), \
+                                CRC32_ENTRIES_16(s, i + 32), CRC32_ENTRIES_16(s, i + 48)
+#define CRC32_ENTRIES_256(s)    { CRC32_ENTRIES_64(s, 0), CRC32_ENTRIES_64(s, 64), \
+                                  CRC32_ENTRIES_64(s, 128), CRC32_ENTRIES_64(s, 192) }
+
+static const uint32_t CRC32Table[CRC32_SLICES][256] CRC32_TABLE_ATTR = {
+    CRC32_ENTRIES_256(0),
+#if CRC32_SLICES == 8
+    CRC32_ENTRIES_256(1),
+    CRC32_ENTRIES_256(2),
+    CRC32_ENTRIES_256(3),
+    CRC32_ENTRIES_256(4),
+    CRC32_ENTRIES_256(5),
+    CRC32_ENTRIES_256(6),
+    CRC32_ENTRIES_256(7),
+#endif
+};
+
+#define CRC32_LOOKUP(slice, index) CRC32_TABLE_READ(CRC32Table[slice][index])
+#endif
+
+#if CRC32_BACKEND == CRC32_BACKEND_SLICING8 || (CRC32_BACKEND == CRC32_BACKEND_HARDWARE && defined(__ARM_FEATURE_CRC32))
+static uint32_t CRC32Word(const uint8_t* buffer)
+{
+    uint32_t value = 0;
+
+    value |= static_cast<uint32_t>(buffer[0]) << 0;
+    value |= static_cast<uint32_t>(buffer[1]) << 8;
+    value |= static_cast<uint32_t>(buffer[2]) << 16;
+    value |= static_cast<uint32_t>(buffer[3]) << 24;
+
+    return value;
+}
+#endif
+
 uint32_t CRC32(uint8_t value) {
     return CRC32(0, &value, 1);
 }
@@ -29,7 +111,7 @@ uint32_t CRC32(const uint8_t* buffer, size_t length) {
     return CRC32(0, buffer, length);
 }
 
-uint32_t CRC32(uint32_t initial, const uint8_t* buffer, size_t length) {
+uint32_t CRC32Bitwise(uint32_t initial, const uint8_t* buffer, size_t length) {
     uint32_t result = initial;
 
     while (length--) {
@@ -38,3 +120,71 @@ uint32_t CRC32(uint32_t initial, const uint8_t* buffer, size_t length) {
 
     return result;
 }
+
+#if CRC32_BACKEND == CRC32_BACKEND_BITWISE
+uint32_t CRC32(uint32_t initial, const uint8_t* buffer, size_t length) {
+    return CRC32Bitwise(initial, buffer, length);
+}
+#elif CRC32_BACKEND == CRC32_BACKEND_TABLE
+uint32_t CRC32(uint32_t initial, const uint8_t* buffer, size_t length) {
+    uint32_t result = initial;
+
+    while (length--) {
+        result = (result >> 8) ^ CRC32_LOOKUP(0, (result ^ *buffer++) & 0xFF);
+    }
+
+    return result;
+}
+#elif CRC32_BACKEND == CRC32_BACKEND_SLICING8
+uint32_t CRC32(uint32_t initial, const uint8_t* buffer, size_t length) {
+    uint32_t result = initial;
+
+    // Process eight bytes at a time. Words are assembled byte-wise, so this
+    // works for unaligned buffers and on big-endian platforms.
+    while (length >= 8) {
+        uint32_t a = CRC32Word(&buffer[0]) ^ result;
+        uint32_t b = CRC32Word(&buffer[4]);
+
+        result = CRC32_LOOKUP(7, (a >> 0) & 0xFF) ^
+                 CRC32_LOOKUP(6, (a >> 8) & 0xFF) ^
+                 CRC32_LOOKUP(5, (a >> 16) & 0xFF) ^
+                 CRC32_LOOKUP(4, (a >> 24) & 0xFF) ^
+                 CRC32_LOOKUP(3, (b >> 0) & 0xFF) ^
+                 CRC32_LOOKUP(2, (b >> 8) & 0xFF) ^
+                 CRC32_LOOKUP(1, (b >> 16) & 0xFF) ^
+                 CRC32_LOOKUP(0, (b >> 24) & 0xFF);
+
+        buffer += 8;
+        length -= 8;
+    }
+
+    // Process the remaining bytes.
+    while (length--) {
+        result = (result >> 8) ^ CRC32_LOOKUP(0, (result ^ *buffer++) & 0xFF);
+    }
+
+    return result;
+}
+#elif CRC32_BACKEND == CRC32_BACKEND_HARDWARE
+uint32_t CRC32(uint32_t initial, const uint8_t* buffer, size_t length) {
+#if defined(__ARM_FEATURE_CRC32)
+    uint32_t result = initial;
+
+    while (length >= 4) {
+        result = __crc32w(result, CRC32Word(buffer));
+
+        buffer += 4;
+        length -= 4;
+    }
+
+    while (length--) {
+        result = __crc32b(result, *buffer++);
+    }
+
+    return result;
+#elif defined(ESP_PLATFORM)
+    // The ROM routine inverts the CRC value on entry and on exit.
+    return ~esp_rom_crc32_le(~initial, buffer, length);
+#endif
+}
+#endif
@@ -1,228 +1,434 @@
 #include "TinyLink.h"
-#include "Crc.h"
+#include "Utils.h"
 
-static uint32_t _read_uint32_t(uint8_t* buffer)
+#include <string.h>
+
+template <class Policy>
+BasicTinyLink<Policy>::BasicTinyLink(Stream& _stream, uint8_t* _buffer, size_t _length) : stream(_stream), decoder(_buffer, _length)
 {
-    uint32_t value = 0;
+    this->maxWriteLength = _length < 0xFFFF ? _length : 0xFFFF;
+
+    this->writing = false;
+    this->writeRemaining = 0;
+    this->writeChecksum = 0;
+
+    this->blockIndex = 0;
 
-    value |= static_cast<uint32_t>(buffer[0]) << 0;
-    value |= static_cast<uint32_t>(buffer[1]) << 8;
-    value |= static_cast<uint32_t>(buffer[2]) << 16;
-    value |= static_cast<uint32_t>(buffer[3]) << 24;
+    this->readBlockIndex = 0;
+    this->readBlockLength = 0;
 
-    return value;
+#if TINYLINK_STATS
+    memset(&this->stats, 0, sizeof(this->stats));
+#endif
+
+#if TINYLINK_TRACE
+    this->traceCallback = NULL;
+    this->traceContext = NULL;
+#endif
 }
 
-static uint16_t _read_uint16_t(uint8_t* buffer)
+template <class Policy>
+void BasicTinyLink<Policy>::writeBlock(const uint8_t* buffer, const size_t length)
 {
-    uint16_t value = 0;
+    TINYLINK_STATS_ADD(bytesOut, length);
+
+    if (this->blockIndex + length > sizeof(this->block)) {
+        this->flushBlock();
 
-    value |= static_cast<uint16_t>(buffer[0]) << 0;
-    value |= static_cast<uint16_t>(buffer[1]) << 8;
+        // Large runs are written directly, without copying.
+        if (length >= sizeof(this->block)) {
+            this->stream.write(buffer, length);
+            return;
+        }
+    }
 
-    return value;
+    memcpy(&this->block[this->blockIndex], buffer, length);
+    this->blockIndex += length;
 }
 
-static void _write_uint16_t(uint8_t* buffer, uint16_t value)
+template <class Policy>
+void BasicTinyLink<Policy>::flushBlock()
 {
-    buffer[0] = (value & 0x00FF) >> 0;
-    buffer[1] = (value & 0xFF00) >> 8;
+    if (this->blockIndex > 0) {
+        this->stream.write(this->block, this->blockIndex);
+        this->blockIndex = 0;
+    }
 }
 
-static uint8_t _read_uint8_t(uint8_t* buffer)
+template <class Policy>
+void BasicTinyLink<Policy>::writeStream(bool preamble, const uint8_t* buffer, const uint16_t length, uint32_t* checksum)
 {
-    uint8_t value = 0;
+    if (preamble) {
+        this->writeBlock(buffer, length);
+    }
+    else {
+        _write_spans(buffer, length, checksum, [this](const uint8_t* span, size_t size) -> bool {
+            this->writeEncoded(span, size);
+            return true;
+        });
+    }
+}
+
+template <>
+void BasicTinyLink<TinyLinkStuffingPolicy>::writeEncoded(const uint8_t* buffer, const size_t length)
+{
+    const uint8_t* end = buffer + length;
 
-    value |= static_cast<uint8_t>(buffer[0]) << 0;
+    while (buffer < end) {
+        // Copy the run of bytes that do not need escaping at once.
+        const uint8_t* escape = _find_escape(buffer, end);
 
-    return value;
+        if (escape > buffer) {
+            this->writeBlock(buffer, escape - buffer);
+        }
+
+        if (escape == end) {
+            break;
+        }
+
+        const uint8_t escaped[2] = {ESCAPE, *escape};
+
+        this->writeBlock(escaped, sizeof(escaped));
+
+        TINYLINK_STATS_ADD(escapesOut, 1);
+
+        buffer = escape + 1;
+    }
 }
 
-static void _write_uint8_t(uint8_t* buffer, uint8_t value)
+template <>
+void BasicTinyLink<TinyLinkStuffingPolicy>::finishEncoded()
 {
-    buffer[0] = (value & 0xFF) >> 0;
 }
 
-TinyLink::TinyLink(Stream& _stream, uint8_t* _buffer, size_t _length) : stream(_stream), buffer(_buffer)
+template <>
+void BasicTinyLink<TinyLinkCobsPolicy>::writeRun(const uint8_t* buffer, const size_t length)
+{
+    // The held back bytes and the given bytes form one run.
+    const uint8_t code = static_cast<uint8_t>(this->encoder.length + length + 1) ^ FLAG;
+
+    this->writeBlock(&code, 1);
+
+    if (this->encoder.length > 0) {
+        this->writeBlock(this->encoder.run, this->encoder.length);
+        this->encoder.length = 0;
+    }
+
+    if (length > 0) {
+        this->writeBlock(buffer, length);
+    }
+}
+
+template <>
+void BasicTinyLink<TinyLinkCobsPolicy>::writeEncoded(const uint8_t* buffer, const size_t length)
 {
-    this->length = _length;
+    const uint8_t* end = buffer + length;
+
+    while (buffer < end) {
+        size_t capacity = COBS_MAX_RUN - this->encoder.length;
+        size_t available = static_cast<size_t>(end - buffer) < capacity ? end - buffer : capacity;
+
+        const uint8_t* separator = static_cast<const uint8_t*>(memchr(buffer, FLAG, available));
+        size_t run = separator ? separator - buffer : available;
+
+        if (separator == NULL && run < capacity) {
+            // The run may continue with the next data, so hold it back.
+            memcpy(&this->encoder.run[this->encoder.length], buffer, run);
+
+            this->encoder.length += run;
+            this->encoder.open = true;
+
+            break;
+        }
+
+        // The run is complete, so write it without copying. A run of maximum
+        // length is not followed by an implied separator, so the next run is
+        // only started when more data follows.
+        this->writeRun(buffer, run);
+
+        this->encoder.open = separator != NULL;
+
+        // The code takes the place of the separator, if any, so it only adds
+        // a byte after a run of maximum length.
+        if (separator == NULL) {
+            TINYLINK_STATS_ADD(escapesOut, 1);
+        }
 
-    this->state = WAITING_FOR_PREAMBLE;
-    this->index = 0;
-    this->unescaping = false;
+        buffer += run + (separator ? 1 : 0);
+    }
 }
 
-uint8_t TinyLink::checksumHeader(const uint16_t flags, const uint16_t length)
+template <>
+void BasicTinyLink<TinyLinkCobsPolicy>::finishEncoded()
 {
-    uint8_t a = (flags  & 0x00FF) >> 0;
-    uint8_t b = (flags  & 0xFF00) >> 8;
-    uint8_t c = (length & 0x00FF) >> 0;
-    uint8_t d = (length & 0xFF00) >> 8;
+    if (this->encoder.open) {
+        this->writeRun(NULL, 0);
 
-    return a ^ b ^ c ^ d;
+        TINYLINK_STATS_ADD(escapesOut, 1);
+    }
+
+    this->encoder.length = 0;
+    this->encoder.open = true;
 }
 
-uint32_t TinyLink::checksumFrame(const uint8_t* header, const uint8_t* payload, const uint16_t length)
+template <class Policy>
+bool BasicTinyLink<Policy>::writeFrame(const frame_t* frame)
 {
-    return CRC32(CRC32(header, 5), payload, length);
+    segment_t segment;
+
+    segment.length = frame->length;
+    segment.data = frame->payload;
+
+    return this->writeFrame(frame->flags, &segment, 1);
 }
 
-void TinyLink::writeStream(bool preamble, const uint8_t* buffer, const uint16_t length)
+template <class Policy>
+bool BasicTinyLink<Policy>::writeFrame(const uint16_t flags, const segment_t* segments, const size_t count)
 {
-    if (preamble) {
-        this->stream.write(buffer, length);
+    size_t length = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        length += segments[i].length;
     }
-    else {
-        for (uint16_t i = 0; i < length; i++) {
-            if (buffer[i] == FLAG) {
-                this->stream.write(ESCAPE);
-                this->stream.write(FLAG);
-            }
-            else if (buffer[i] == ESCAPE) {
-                this->stream.write(ESCAPE);
-                this->stream.write(ESCAPE);
-            }
-            else {
-                this->stream.write(buffer[i]);
-            }
-        }
+
+    // Do not exceed maximum length.
+    if (length > 0xFFFF || !this->beginFrame(flags, static_cast<uint16_t>(length))) {
+        return false;
     }
+
+    // Send body. The checksum is updated while sending.
+    for (size_t i = 0; i < count; i++) {
+        this->writeStream(false, segments[i].data, segments[i].length, &this->writeChecksum);
+    }
+
+    this->writeRemaining = 0;
+
+    return this->endFrame();
+}
+
+template <class Policy>
+bool BasicTinyLink<Policy>::write(const uint16_t flags, const void* payload, const uint16_t length)
+{
+    frame_t frame;
+
+    frame.length = length;
+    frame.flags = flags;
+    frame.payload = static_cast<const uint8_t*>(payload);
+
+    return this->writeFrame(&frame);
 }
 
-bool TinyLink::writeFrame(const frame_t* frame)
+template <class Policy>
+bool BasicTinyLink<Policy>::beginFrame(const uint16_t flags, const uint16_t length)
 {
     // Do not exceed maximum length.
-    if (frame->length > this->length) {
+    if (this->writing || length > this->maxWriteLength) {
         return false;
     }
 
+    TINYLINK_TRACE_EVENT(TRACE_ENCODE_BEGIN);
+
     // Send preamble.
     uint32_t preamble = PREAMBLE;
 
-    this->writeStream(true, reinterpret_cast<uint8_t*>(&preamble), 4);
+    this->writeStream(true, reinterpret_cast<uint8_t*>(&preamble), 4, NULL);
 
     // Send header.
-    uint8_t header[5];
-    uint8_t checksumHeader = this->checksumHeader(frame->flags, frame->length);
+    uint8_t header[LEN_HEADER];
+
+    _write_header(header, flags, length);
 
-    _write_uint16_t(&header[0], frame->flags);
-    _write_uint16_t(&header[2], frame->length);
-    _write_uint8_t(&header[4], checksumHeader);
+    this->writeChecksum = 0;
+    this->writeStream(false, reinterpret_cast<uint8_t*>(header), sizeof(header), &this->writeChecksum);
 
-    this->writeStream(false, reinterpret_cast<uint8_t*>(header), sizeof(header));
+    this->writing = true;
+    this->writeRemaining = length;
 
-    // Send body.
-    uint32_t checksumFrame = this->checksumFrame(header, frame->payload, frame->length);
+    return true;
+}
+
+template <class Policy>
+bool BasicTinyLink<Policy>::appendFrame(const void* payload, const uint16_t length)
+{
+    if (!this->writing || length > this->writeRemaining) {
+        return false;
+    }
+
+    // Send body. The checksum is updated while sending. Flush the data, so it
+    // is not held back until the frame ends.
+    this->writeStream(false, static_cast<const uint8_t*>(payload), length, &this->writeChecksum);
+    this->flushBlock();
 
-    this->writeStream(false, frame->payload, frame->length);
-    this->writeStream(false, reinterpret_cast<uint8_t*>(&checksumFrame), 4);
+    this->writeRemaining -= length;
 
     return true;
 }
 
-bool TinyLink::write(const uint16_t flags, const void* payload, const uint16_t length)
+template <class Policy>
+bool BasicTinyLink<Policy>::endFrame()
 {
-    frame_t frame;
+    if (!this->writing) {
+        return false;
+    }
 
-    frame.length = length;
-    frame.flags = flags;
-    frame.payload = static_cast<const uint8_t*>(payload);
+    this->writing = false;
 
-    return this->writeFrame(&frame);
+    if (this->writeRemaining > 0) {
+        // Abort the frame. The other side detects this, because the frame will
+        // be shorter than announced, or the checksum will not match.
+        this->finishEncoded();
+        this->flushBlock();
+
+        TINYLINK_TRACE_EVENT(TRACE_ENCODE_END);
+
+        return false;
+    }
+
+    this->writeStream(false, reinterpret_cast<uint8_t*>(&this->writeChecksum), 4, NULL);
+    this->finishEncoded();
+    this->flushBlock();
+
+    TINYLINK_STATS_ADD(framesOut, 1);
+    TINYLINK_TRACE_EVENT(TRACE_ENCODE_END);
+
+    return true;
 }
 
-bool TinyLink::readFrame(frame_t* frame)
+template <class Policy>
+void BasicTinyLink<Policy>::setMaxWriteLength(const uint16_t length)
 {
-    uint8_t byte = this->stream.read();
+    this->maxWriteLength = length;
+}
 
-    // Unescape and append to buffer.
-    if (this->state == WAITING_FOR_HEADER || this->state == WAITING_FOR_BODY) {
-        if (this->unescaping) {
-            this->index -= 1;
-            this->unescaping = false;
-        }
-        else if (byte == ESCAPE) {
-            this->unescaping = true;
-        }
+template <class Policy>
+bool BasicTinyLink<Policy>::readFrame(frame_t* frame)
+{
+    // Bytes left over from `pollFrame` come first.
+    if (this->readBlockIndex < this->readBlockLength) {
+        return this->decoder.push(this->readBlock[this->readBlockIndex++], frame);
     }
 
-    this->buffer[this->index++] = byte;
+    int value = this->stream.read();
 
-    if (this->unescaping) {
-        return false;
+    if (value < 0) {
+        return this->drainFrame(frame);
     }
 
-    // Decide what to do.
-    switch (this->state) {
-        case WAITING_FOR_PREAMBLE:
-        {
-            if (this->index >= LEN_PREAMBLE) {
-                uint32_t preamble = _read_uint32_t(&this->buffer[this->index - LEN_PREAMBLE]);
-
-                if (preamble == PREAMBLE) {
-                    // Preamble found, advance state.
-                    this->state = WAITING_FOR_HEADER;
-                    this->index = 0;
-                } else if (this->index == this->length) {
-                    // Preamble not found and buffer is full. Copy last four
-                    // bytes, because the next byte may form the preamble
-                    // together with the last three bytes.
-                    memcpy(this->buffer, &this->buffer[this->index - 4], LEN_PREAMBLE);
-                    this->index = LEN_PREAMBLE;
-                }
-            }
+    return this->decoder.push(static_cast<uint8_t>(value), frame);
+}
 
-            break;
-        }
-        case WAITING_FOR_HEADER:
-        {
-            if (this->index == LEN_HEADER) {
-                uint16_t flags = _read_uint16_t(&this->buffer[0]);
-                uint16_t length = _read_uint16_t(&this->buffer[2]);
-                uint8_t checksumHeader = _read_uint8_t(&this->buffer[4]);
-
-                if (checksumHeader == this->checksumHeader(flags, length) && length <= this->length - LEN_HEADER - LEN_BODY - 1) {
-                    this->state = WAITING_FOR_BODY;
-                } else {
-                    // Reset to start state.
-                    this->state = WAITING_FOR_PREAMBLE;
-                    this->index = 0;
-                }
+template <class Policy>
+bool BasicTinyLink<Policy>::pollFrame(frame_t* frame)
+{
+    // Limit the number of bytes to what is available now, so this method
+    // returns even if data keeps coming in.
+    int available = this->stream.available();
+
+    while (true) {
+        if (this->readBlockIndex < this->readBlockLength) {
+            size_t consumed;
+            bool decoded = this->decoder.feed(
+                &this->readBlock[this->readBlockIndex], this->readBlockLength - this->readBlockIndex, &consumed, frame);
+
+            this->readBlockIndex += consumed;
+
+            if (decoded) {
+                return true;
             }
+        }
 
-            break;
+        if (available <= 0) {
+            return this->drainFrame(frame);
         }
-        case WAITING_FOR_BODY:
-        {
-            uint16_t flags = _read_uint16_t(&this->buffer[0]);
-            uint16_t length = _read_uint16_t(&this->buffer[2]);
-
-            if (this->index == LEN_HEADER + length + LEN_CRC) {
-                uint32_t checksumFrame = _read_uint32_t(&this->buffer[this->index - LEN_CRC]);
-
-                // Reset to start state.
-                this->state = WAITING_FOR_PREAMBLE;
-                this->index = 0;
-
-                // Copy to frame.
-                if (checksumFrame == this->checksumFrame(&this->buffer[0], &this->buffer[5], length)) {
-                    frame->flags = flags;
-                    frame->length = length;
-                    frame->payload = &this->buffer[LEN_HEADER];
-
-                    return true;
-                }
-            }
 
-            break;
+        size_t length = static_cast<size_t>(available) < sizeof(this->readBlock) ? available : sizeof(this->readBlock);
+
+        this->readBlockIndex = 0;
+        this->readBlockLength = this->stream.readBytes(this->readBlock, length);
+
+        if (this->readBlockLength == 0) {
+            return this->drainFrame(frame);
         }
+
+        available -= static_cast<int>(this->readBlockLength);
     }
+}
+
+template <class Policy>
+bool BasicTinyLink<Policy>::drainFrame(frame_t* frame)
+{
+    // Frames recovered from a rejected frame may be pending, even if no more
+    // bytes arrive.
+    size_t consumed;
 
-    // No frames processed.
-    return false;
+    return this->decoder.feed(NULL, 0, &consumed, frame);
 }
 
-bool TinyLink::read(void* buffer, const uint16_t length)
+template <class Policy>
+bool BasicTinyLink<Policy>::setChunkCallback(tinylink_chunk_callback_t callback, void* context)
+{
+    return this->decoder.setChunkCallback(callback, context);
+}
+
+template <class Policy>
+void BasicTinyLink<Policy>::setDestination(void* buffer, uint16_t length)
+{
+    this->decoder.setDestination(buffer, length);
+}
+
+template <class Policy>
+void BasicTinyLink<Policy>::setDestinationCallback(tinylink_destination_callback_t callback, void* context)
+{
+    this->decoder.setDestinationCallback(callback, context);
+}
+
+template <class Policy>
+void BasicTinyLink<Policy>::setResyncBuffer(void* buffer, size_t length)
+{
+    this->decoder.setResyncBuffer(buffer, length);
+}
+
+template <class Policy>
+void BasicTinyLink<Policy>::setTimeout(tinylink_clock_callback_t clock, uint32_t byteTimeout, uint32_t frameTimeout)
+{
+    this->decoder.setTimeout(clock, byteTimeout, frameTimeout);
+}
+
+#if TINYLINK_STATS
+template <class Policy>
+tinylink_stats_t BasicTinyLink<Policy>::getStats() const
+{
+    tinylink_stats_t stats = this->decoder.getStats();
+
+    stats.framesOut = this->stats.framesOut;
+    stats.bytesOut = this->stats.bytesOut;
+    stats.escapesOut = this->stats.escapesOut;
+
+    return stats;
+}
+
+template <class Policy>
+void BasicTinyLink<Policy>::resetStats()
+{
+    this->decoder.resetStats();
+
+    memset(&this->stats, 0, sizeof(this->stats));
+}
+#endif
+
+#if TINYLINK_TRACE
+template <class Policy>
+void BasicTinyLink<Policy>::setTraceCallback(tinylink_trace_callback_t callback, void* context)
+{
+    this->decoder.setTraceCallback(callback, context);
+
+    this->traceCallback = callback;
+    this->traceContext = context;
+}
+#endif
+
+template <class Policy>
+bool BasicTinyLink<Policy>::read(void* buffer, const uint16_t length)
 {
     frame_t frame;
 
@@ -238,3 +444,6 @@ bool TinyLink::read(void* buffer, const uint16_t length)
 
     return true;
 }
+
+template class BasicTinyLink<TinyLinkStuffingPolicy>;
+template class BasicTinyLink<TinyLinkCobsPolicy>;
@@ -0,0 +1,140 @@
+#include "TinyLinkAggregator.h"
+
+#include <string.h>
+
+template <class Policy>
+BasicTinyLinkAggregator<Policy>::BasicTinyLinkAggregator(BasicTinyLink<Policy>& _link, uint8_t* _buffer, size_t _length) : link(_link)
+{
+    this->buffer = _buffer;
+    this->length = _length < 0xFFFF ? _length : 0xFFFF;
+    this->index = 0;
+
+    this->flags = 0;
+
+    this->clock = NULL;
+    this->timeout = 0;
+    this->started = 0;
+}
+
+template <class Policy>
+bool BasicTinyLinkAggregator<Policy>::write(const void* message, const uint8_t length)
+{
+    size_t size = LEN_MESSAGE_PREFIX + length;
+
+    if (size > this->length) {
+        return false;
+    }
+
+    if (this->index + size > this->length) {
+        if (!this->flush()) {
+            return false;
+        }
+    }
+
+    if (this->index == 0 && this->clock) {
+        this->started = this->clock();
+    }
+
+    this->buffer[this->index] = length;
+    memcpy(&this->buffer[this->index + LEN_MESSAGE_PREFIX], message, length);
+
+    this->index += size;
+
+    return true;
+}
+
+template <class Policy>
+bool BasicTinyLinkAggregator<Policy>::flush()
+{
+    if (this->index == 0) {
+        return true;
+    }
+
+    // Keep the messages if writing fails, so they are written on the next
+    // attempt.
+    if (!this->link.write(this->flags | FLAGS_AGGREGATE, this->buffer, static_cast<uint16_t>(this->index))) {
+        return false;
+    }
+
+    this->index = 0;
+
+    return true;
+}
+
+template <class Policy>
+bool BasicTinyLinkAggregator<Policy>::poll()
+{
+    if (this->index == 0 || !this->clock) {
+        return false;
+    }
+
+    // Unsigned arithmetic handles clock overflows.
+    if (this->clock() - this->started < this->timeout) {
+        return false;
+    }
+
+    return this->flush();
+}
+
+template <class Policy>
+void BasicTinyLinkAggregator<Policy>::setTimeout(tinylink_clock_callback_t clock, uint32_t timeout)
+{
+    this->clock = clock;
+    this->timeout = timeout;
+
+    if (this->index > 0 && clock) {
+        this->started = clock();
+    }
+}
+
+template <class Policy>
+void BasicTinyLinkAggregator<Policy>::setFlags(const uint16_t flags)
+{
+    this->flags = flags;
+}
+
+template <class Policy>
+size_t BasicTinyLinkAggregator<Policy>::getPending() const
+{
+    return this->index;
+}
+
+template class BasicTinyLinkAggregator<TinyLinkStuffingPolicy>;
+template class BasicTinyLinkAggregator<TinyLinkCobsPolicy>;
+
+TinyLinkUnpacker::TinyLinkUnpacker(const frame_t* _frame)
+{
+    this->data = _frame->payload;
+    this->end = _frame->payload;
+
+    if (TinyLinkUnpacker::isAggregate(_frame)) {
+        this->end += _frame->length;
+    }
+}
+
+bool TinyLinkUnpacker::next(const uint8_t** message, uint8_t* length)
+{
+    if (this->end - this->data < LEN_MESSAGE_PREFIX) {
+        return false;
+    }
+
+    uint8_t size = *this->data;
+
+    if (this->end - this->data - LEN_MESSAGE_PREFIX < size) {
+        // Truncated message, so stop iterating.
+        this->data = this->end;
+        return false;
+    }
+
+    *message = this->data + LEN_MESSAGE_PREFIX;
+    *length = size;
+
+    this->data += LEN_MESSAGE_PREFIX + size;
+
+    return true;
+}
+
+bool TinyLinkUnpacker::isAggregate(const frame_t* frame)
+{
+    return (frame->flags & FLAGS_AGGREGATE) != 0;
+}
@@ -0,0 +1,231 @@
+#include "TinyLinkCapture.h"
+
+#ifdef TINYLINK_HAS_CAPTURE
+
+#include "TinyLinkDecoder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Number of chunks per thread when decoding a file. More chunks than threads
+// balance the work when some chunks take longer.
+#define CAPTURE_CHUNKS_PER_THREAD 4
+
+// Size of the buffer of every decoder. Payloads are received in chunks, so
+// the buffer does not limit the length of a frame.
+#define CAPTURE_BUFFER_SIZE 256
+
+namespace {
+
+/**
+ * @brief Part of a capture, decoded as if the decoder was waiting for a
+ * preamble at its start.
+ */
+struct part_t {
+    part_t(size_t _begin, size_t _end, uint16_t maxLength) : decoder(buffer, sizeof(buffer))
+    {
+        this->begin = _begin;
+        this->end = _end;
+        this->output = &this->frames;
+
+        this->decoder.setChunkCallback(part_t::record, this);
+        this->decoder.setMaxLength(maxLength);
+    }
+
+    /**
+     * @brief Decode the bytes from `position` up to `stop`, which continue the
+     * bytes decoded before.
+     */
+    void decode(const uint8_t* data, size_t position, size_t stop)
+    {
+        frame_t frame;
+        size_t consumed;
+
+        // Payloads are received in chunks, so no frame is returned.
+        this->decoder.feed(&data[position], stop - position, &consumed, &frame);
+    }
+
+    /**
+     * @brief Return whether the last bytes decoded are the preamble at
+     * `offset`.
+     */
+    bool synchronized(uint64_t offset) const
+    {
+        return this->decoder.getState() == WAITING_FOR_HEADER && this->begin + this->decoder.getFrameOffset() == offset;
+    }
+
+    static void record(tinylink_chunk_e event, const chunk_t* chunk, void* context)
+    {
+        part_t* part = static_cast<part_t*>(context);
+
+        if (event == CHUNK_DATA) {
+            return;
+        }
+
+        capture_frame_t frame;
+
+        frame.offset = part->begin + part->decoder.getFrameOffset();
+        frame.flags = chunk->flags;
+        frame.length = chunk->length;
+        frame.valid = event == CHUNK_VALID;
+
+        part->output->push_back(frame);
+    }
+
+    size_t begin;
+    size_t end;
+
+    // Frames found, which are appended to `output`.
+    std::vector<capture_frame_t> frames;
+    std::vector<capture_frame_t>* output;
+
+    uint8_t buffer[CAPTURE_BUFFER_SIZE];
+    TinyLinkDecoder decoder;
+};
+
+}
+
+void TinyLinkCapture::decode(const uint8_t* data, size_t length, size_t threads, size_t chunks, uint16_t maxLength, std::vector<capture_frame_t>* frames)
+{
+    if (threads == 0) {
+        threads = 1;
+    }
+
+    if (chunks == 0) {
+        chunks = 1;
+    }
+
+    // Split the capture at candidate preambles, so a part most likely starts
+    // with a frame. A deque keeps the decoders in place.
+    static const uint8_t preamble[LEN_PREAMBLE] = {
+        (PREAMBLE >> 0) & 0xFF, (PREAMBLE >> 8) & 0xFF, (PREAMBLE >> 16) & 0xFF, (PREAMBLE >> 24) & 0xFF
+    };
+
+    std::deque<part_t> parts;
+    size_t begin = 0;
+
+    for (size_t i = 1; i <= chunks && begin < length; i++) {
+        size_t end = length;
+
+        if (i < chunks) {
+            size_t split = static_cast<size_t>(static_cast<uint64_t>(length) * i / chunks);
+
+            if (split > begin) {
+                const uint8_t* candidate = std::search(&data[split], &data[length], preamble, preamble + LEN_PREAMBLE);
+
+                end = candidate - data;
+            } else {
+                continue;
+            }
+        }
+
+        parts.emplace_back(begin, end, maxLength);
+
+        begin = end;
+    }
+
+    // Decode the parts in parallel.
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> workers;
+
+    for (size_t i = 0; i < threads && i < parts.size(); i++) {
+        workers.push_back(std::thread([&]() {
+            size_t index;
+
+            while ((index = next.fetch_add(1)) < parts.size()) {
+                parts[index].decode(data, parts[index].begin, parts[index].end);
+            }
+        }));
+    }
+
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i].join();
+    }
+
+    if (parts.empty()) {
+        return;
+    }
+
+    // The first part starts in the actual state. Its decoder continues across
+    // every boundary until it finds the preamble of a frame that the next part
+    // found as well. From there on, the decoders are in the same state, so the
+    // decoder of that part continues instead.
+    part_t* current = &parts[0];
+    size_t position = current->end;
+
+    frames->insert(frames->end(), current->frames.begin(), current->frames.end());
+    current->output = frames;
+
+    for (size_t index = 1; index < parts.size(); index++) {
+        part_t* part = &parts[index];
+
+        for (size_t i = 0; i < part->frames.size(); i++) {
+            size_t sync = part->frames[i].offset + LEN_PREAMBLE;
+
+            if (sync <= position) {
+                continue;
+            }
+
+            current->decode(data, position, sync);
+            position = sync;
+
+            if (current->synchronized(part->frames[i].offset)) {
+                frames->insert(frames->end(), part->frames.begin() + i, part->frames.end());
+
+                current = part;
+                current->output = frames;
+                position = current->end;
+
+                break;
+            }
+        }
+    }
+
+    current->decode(data, position, length);
+}
+
+bool TinyLinkCapture::decodeFile(const char* path, size_t threads, std::vector<capture_frame_t>* frames)
+{
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat status;
+
+    if (fstat(fd, &status) < 0) {
+        close(fd);
+        return false;
+    }
+
+    size_t length = static_cast<size_t>(status.st_size);
+
+    if (length == 0) {
+        close(fd);
+        return true;
+    }
+
+    void* data = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        return false;
+    }
+
+    TinyLinkCapture::decode(static_cast<const uint8_t*>(data), length, threads, threads * CAPTURE_CHUNKS_PER_THREAD, 0xFFFF, frames);
+
+    munmap(data, length);
+
+    return true;
+}
+
+#endif
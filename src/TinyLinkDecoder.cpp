@@ -0,0 +1,933 @@
+#include "TinyLinkDecoder.h"
+#include "Crc.h"
+#include "Utils.h"
+
+#include <string.h>
+
+template <class Policy>
+BasicTinyLinkDecoder<Policy>::BasicTinyLinkDecoder(uint8_t* _buffer, size_t _length) : buffer(_buffer)
+{
+    this->length = _length;
+
+    this->state = WAITING_FOR_PREAMBLE;
+    this->chunkCallback = NULL;
+    this->chunkContext = NULL;
+
+    this->destination = NULL;
+    this->destinationLength = 0;
+    this->destinationCallback = NULL;
+    this->destinationContext = NULL;
+
+    this->resync = NULL;
+    this->resyncSize = 0;
+    this->resyncLength = 0;
+    this->resyncIndex = 0;
+
+    this->maxLength = 0xFFFF;
+    this->position = 0;
+    this->frameOffset = 0;
+
+    this->clock = NULL;
+    this->byteTimeout = 0;
+    this->frameTimeout = 0;
+    this->byteTime = 0;
+    this->frameTime = 0;
+
+#if TINYLINK_STATS
+    this->resetStats();
+    this->hunted = 0;
+#endif
+
+#if TINYLINK_TRACE
+    this->traceCallback = NULL;
+    this->traceContext = NULL;
+#endif
+
+    this->reset();
+}
+
+template <class Policy>
+void BasicTinyLinkDecoder<Policy>::reset()
+{
+    this->restart();
+
+    // The bytes left in the window will not be part of a preamble.
+    TINYLINK_STATS_ADD(huntSkipped, this->hunted);
+
+#if TINYLINK_STATS
+    this->hunted = 0;
+#endif
+
+    this->window = 0;
+
+    // Bytes that were queued to be scanned again are skipped.
+    this->position += this->resyncLength - this->resyncIndex;
+
+    this->resyncLength = 0;
+    this->resyncIndex = 0;
+    this->resyncOverflow = false;
+    this->resyncMarked = false;
+}
+
+template <class Policy>
+void BasicTinyLinkDecoder<Policy>::restart()
+{
+    // Signal that a frame received in chunks will not complete.
+    if (this->state == WAITING_FOR_BODY) {
+        if (this->chunkCallback != NULL) {
+            this->payloadIndex = 0;
+            this->deliverChunk(CHUNK_INVALID);
+        }
+        else {
+            this->discardPayload();
+        }
+    }
+
+    // A frame that is aborted ends here.
+    if (this->state != WAITING_FOR_PREAMBLE) {
+        TINYLINK_TRACE_EVENT(TRACE_DECODE_END);
+    }
+
+    this->state = WAITING_FOR_PREAMBLE;
+    this->index = 0;
+    this->policy.reset();
+    this->checksum = 0;
+
+    this->frameFlags = 0;
+    this->frameLength = 0;
+    this->payload = NULL;
+    this->payloadIndex = 0;
+}
+
+template <class Policy>
+tinylink_state_e BasicTinyLinkDecoder<Policy>::getState() const
+{
+    return this->state;
+}
+
+template <class Policy>
+size_t BasicTinyLinkDecoder<Policy>::getFrameOffset() const
+{
+    return this->frameOffset;
+}
+
+template <class Policy>
+bool BasicTinyLinkDecoder<Policy>::push(uint8_t byte, frame_t* frame)
+{
+    if (this->clock != NULL) {
+        this->expire(this->clock());
+    }
+
+    TINYLINK_STATS_ADD(bytesIn, 1);
+
+    do {
+        if (this->resyncIndex < this->resyncLength) {
+            // Bytes are being scanned again, so queue this byte after them. If
+            // there is no room, scan them first.
+            if (this->resyncLength == this->resyncSize && this->replay(frame)) {
+                // The decoder waits for a preamble after a frame, so only the
+                // bytes that were not scanned yet have to be kept, which frees
+                // room for this byte.
+                this->trim();
+
+                if (this->resyncLength == 0) {
+                    // Waiting for a preamble, so this cannot complete a frame.
+                    this->process(byte, frame);
+                }
+                else {
+                    this->resync[this->resyncLength++] = byte;
+                }
+
+                return true;
+            }
+
+            if (this->resyncIndex < this->resyncLength) {
+                this->resync[this->resyncLength++] = byte;
+
+                return this->replay(frame);
+            }
+        }
+    } while (this->abandon());
+
+    return this->process(byte, frame);
+}
+
+template <class Policy>
+bool BasicTinyLinkDecoder<Policy>::feed(const uint8_t* data, size_t length, size_t* consumed, frame_t* frame)
+{
+    if (this->clock != NULL && length > 0) {
+        this->expire(this->clock());
+    }
+
+    size_t i = 0;
+
+    while (true) {
+        // Bytes that are scanned again come first.
+        if (this->resyncIndex < this->resyncLength && this->replay(frame)) {
+            TINYLINK_STATS_ADD(bytesIn, i);
+
+            *consumed = i;
+            return true;
+        }
+
+        if (i == length) {
+            break;
+        }
+
+        if (this->state == WAITING_FOR_PREAMBLE && !this->resyncMarked) {
+            i += this->hunt(&data[i], length - i);
+            continue;
+        }
+
+        if (this->abandon()) {
+            continue;
+        }
+
+        if (this->state == WAITING_FOR_BODY) {
+            size_t count = this->receive(&data[i], length - i);
+
+            if (count > 0) {
+                i += count;
+                continue;
+            }
+        }
+
+        if (this->process(data[i++], frame)) {
+            TINYLINK_STATS_ADD(bytesIn, i);
+
+            *consumed = i;
+            return true;
+        }
+    }
+
+    TINYLINK_STATS_ADD(bytesIn, i);
+
+    *consumed = i;
+    return false;
+}
+
+template <class Policy>
+size_t BasicTinyLinkDecoder<Policy>::feed(const uint8_t* data, size_t length, tinylink_frame_callback_t callback, void* context)
+{
+    size_t frames = 0;
+    frame_t frame;
+
+    if (this->clock != NULL && length > 0) {
+        this->expire(this->clock());
+    }
+
+    size_t i = 0;
+
+    while (true) {
+        // Bytes that are scanned again come first.
+        while (this->resyncIndex < this->resyncLength) {
+            if (this->replay(&frame)) {
+                callback(&frame, context);
+                frames++;
+            }
+        }
+
+        if (i == length) {
+            break;
+        }
+
+        if (this->state == WAITING_FOR_PREAMBLE && !this->resyncMarked) {
+            i += this->hunt(&data[i], length - i);
+            continue;
+        }
+
+        if (this->abandon()) {
+            continue;
+        }
+
+        if (this->state == WAITING_FOR_BODY) {
+            size_t count = this->receive(&data[i], length - i);
+
+            if (count > 0) {
+                i += count;
+                continue;
+            }
+        }
+
+        if (this->process(data[i++], &frame)) {
+            callback(&frame, context);
+            frames++;
+        }
+    }
+
+    TINYLINK_STATS_ADD(bytesIn, length);
+
+    return frames;
+}
+
+template <class Policy>
+size_t BasicTinyLinkDecoder<Policy>::hunt(const uint8_t* data, size_t length)
+{
+    const uint8_t* start = data;
+    const uint8_t* end = data + length;
+
+    while (data < end) {
+        // Skip to the next byte that can complete the preamble. Only the bytes
+        // before it are shifted into the window.
+        const uint8_t* candidate = static_cast<const uint8_t*>(memchr(data, static_cast<uint8_t>(PREAMBLE >> 24), end - data));
+
+        if (candidate == NULL) {
+            this->window = _shift_window(this->window, data, end);
+            this->skip(end - data);
+            break;
+        }
+
+        this->window = _shift_window(this->window, data, candidate + 1);
+
+        if (this->window == PREAMBLE) {
+            // The candidate completes the preamble, so only the bytes before
+            // it can have left the window.
+            this->skip(candidate - data);
+            this->position += candidate + 1 - start;
+            this->synchronize();
+
+            return candidate + 1 - start;
+        }
+
+        this->skip(candidate + 1 - data);
+        data = candidate + 1;
+    }
+
+    this->position += length;
+
+    return length;
+}
+
+template <class Policy>
+void BasicTinyLinkDecoder<Policy>::synchronize()
+{
+    // Preamble found, advance state.
+    this->state = WAITING_FOR_HEADER;
+    this->index = 0;
+    this->checksum = 0;
+    this->window = 0;
+    this->policy.reset();
+
+    this->frameTime = this->byteTime;
+    this->frameOffset = this->position - LEN_PREAMBLE;
+
+    // The bytes in the window are the preamble, so they are not skipped.
+#if TINYLINK_STATS
+    this->hunted = 0;
+#endif
+
+    TINYLINK_TRACE_EVENT(TRACE_DECODE_BEGIN);
+}
+
+template <class Policy>
+void BasicTinyLinkDecoder<Policy>::skip(size_t count)
+{
+#if TINYLINK_STATS
+    // Count bytes shifted into the window once they can no longer be part of
+    // a preamble, so that nothing has to be subtracted when one is found.
+    size_t hunted = this->hunted + count;
+
+    if (hunted >= LEN_PREAMBLE) {
+        TINYLINK_STATS_ADD(huntSkipped, hunted - (LEN_PREAMBLE - 1));
+        hunted = LEN_PREAMBLE - 1;
+    }
+
+    this->hunted = static_cast<uint8_t>(hunted);
+#else
+    (void) count;
+#endif
+}
+
+template <class Policy>
+bool BasicTinyLinkDecoder<Policy>::replay(frame_t* frame)
+{
+    while (this->resyncIndex < this->resyncLength) {
+        if (this->state == WAITING_FOR_PREAMBLE) {
+            // Hunt up to the last preamble that starts before the mark, where
+            // the decoder would have continued without scanning again.
+            size_t end = this->resyncLength;
+
+            if (this->resyncMarked && end > this->resyncMark + LEN_PREAMBLE - 1) {
+                end = this->resyncMark + LEN_PREAMBLE - 1;
+            }
+
+            this->resyncIndex += this->hunt(&this->resync[this->resyncIndex], end - this->resyncIndex);
+
+            if (this->state != WAITING_FOR_PREAMBLE) {
+                TINYLINK_STATS_ADD(resyncs, 1);
+
+                // Without scanning again, the decoder would have shifted the
+                // rest of a preamble that ends after the mark into its window.
+                // Unless that completes the preamble as well, the frame is
+                // still one found by scanning again.
+                if (this->resyncMarked && this->resyncIndex > this->resyncMark) {
+                    this->resyncMarkWindow = _shift_window(this->resyncMarkWindow, &this->resync[this->resyncMark], &this->resync[this->resyncIndex]);
+
+                    if (this->resyncMarkWindow != PREAMBLE) {
+                        this->resyncMark = this->resyncIndex;
+                    }
+                }
+            }
+            else if (this->resyncMarked && this->resyncIndex >= this->resyncMark) {
+                // A preamble that starts before the mark may end in the next
+                // bytes, so wait for them.
+                if (this->resyncIndex < this->resyncMark + LEN_PREAMBLE - 1) {
+                    break;
+                }
+
+                // No preamble starts before the mark, so hunting continues
+                // with the bytes before it still in the window.
+                this->resyncMarked = false;
+            }
+
+            // Only keep the bytes after the preamble.
+            this->trim();
+            continue;
+        }
+
+        if (this->step(this->resync[this->resyncIndex++], frame)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+template <class Policy>
+bool BasicTinyLinkDecoder<Policy>::backtrack(size_t mark, uint32_t window)
+{
+    // Scan the bytes after the preamble again. The preamble itself is kept in
+    // the window, because the next preamble may overlap with it.
+    if (this->resync != NULL && !this->resyncOverflow && this->resyncLength > 0) {
+        // Remember where decoding would have continued, unless this frame was
+        // found by scanning again, in which case that is already known.
+        if (!this->resyncMarked) {
+            this->resyncMark = mark;
+            this->resyncMarkWindow = window;
+            this->resyncMarked = true;
+        }
+
+        // Continue at the offset of the first byte after the preamble.
+        this->position -= this->resyncIndex;
+        this->resyncIndex = 0;
+        this->window = PREAMBLE;
+
+        // The preamble counts as skipped unless it turns out to overlap with
+        // the next one.
+        this->skip(LEN_PREAMBLE);
+
+        return true;
+    }
+
+    this->resyncLength = 0;
+    this->resyncIndex = 0;
+    this->resyncOverflow = false;
+    this->resyncMarked = false;
+
+    return false;
+}
+
+template <class Policy>
+void BasicTinyLinkDecoder<Policy>::resume()
+{
+    // Continue hunting as if the bytes were never scanned again. The bytes in
+    // the window will not be part of a preamble.
+    TINYLINK_STATS_ADD(huntSkipped, this->hunted);
+
+#if TINYLINK_STATS
+    this->hunted = 0;
+#endif
+
+    this->window = this->resyncMarkWindow;
+    this->resyncMarked = false;
+}
+
+template <class Policy>
+bool BasicTinyLinkDecoder<Policy>::abandon()
+{
+    // A frame found by scanning again may claim more bytes than fit, as may
+    // the bytes hunted for a preamble that starts before the mark. Rather than
+    // losing the bytes after the mark, which may hold a frame that would have
+    // been received without scanning again, abandon them and hunt from the
+    // mark.
+    if (!this->resyncMarked || this->resyncLength < this->resyncSize) {
+        return false;
+    }
+
+    this->restart();
+
+    this->position -= this->resyncLength - this->resyncMark;
+    this->resyncIndex = this->resyncMark;
+    this->resume();
+    this->trim();
+
+    return true;
+}
+
+template <class Policy>
+void BasicTinyLinkDecoder<Policy>::trim()
+{
+    if (this->resyncIndex < this->resyncLength) {
+        memmove(this->resync, &this->resync[this->resyncIndex], this->resyncLength - this->resyncIndex);
+    }
+
+    // The mark moves along with the bytes. Decoding has caught up when a frame
+    // found by scanning again ends at or after it.
+    if (this->resyncMarked) {
+        if (this->resyncMark < this->resyncIndex) {
+            this->resyncMarked = false;
+        }
+        else {
+            this->resyncMark -= this->resyncIndex;
+
+            if (this->resyncMark == 0 && this->state == WAITING_FOR_PREAMBLE) {
+                this->resume();
+            }
+        }
+    }
+
+    this->resyncLength -= this->resyncIndex;
+    this->resyncIndex = 0;
+}
+
+template <class Policy>
+void BasicTinyLinkDecoder<Policy>::setResyncBuffer(void* buffer, size_t length)
+{
+    this->reset();
+
+    this->resync = static_cast<uint8_t*>(buffer);
+    this->resyncSize = buffer != NULL ? length : 0;
+}
+
+template <class Policy>
+void BasicTinyLinkDecoder<Policy>::setTimeout(tinylink_clock_callback_t clock, uint32_t byteTimeout, uint32_t frameTimeout)
+{
+    this->clock = clock;
+    this->byteTimeout = byteTimeout;
+    this->frameTimeout = frameTimeout;
+
+    if (clock != NULL) {
+        this->byteTime = clock();
+        this->frameTime = this->byteTime;
+    }
+}
+
+template <class Policy>
+bool BasicTinyLinkDecoder<Policy>::expire()
+{
+    if (this->clock == NULL) {
+        return false;
+    }
+
+    // Do not count this call as the arrival of bytes.
+    uint32_t byteTime = this->byteTime;
+    bool expired = this->expire(this->clock());
+
+    this->byteTime = byteTime;
+
+    return expired;
+}
+
+template <class Policy>
+bool BasicTinyLinkDecoder<Policy>::expire(uint32_t now)
+{
+    bool expired = false;
+
+    // Unsigned arithmetic handles clock overflows.
+    if (this->state != WAITING_FOR_PREAMBLE) {
+        if (this->byteTimeout > 0 && now - this->byteTime >= this->byteTimeout) {
+            expired = true;
+        }
+        else if (this->frameTimeout > 0 && now - this->frameTime >= this->frameTimeout) {
+            expired = true;
+        }
+    }
+
+    if (expired) {
+        this->reset();
+    }
+
+    this->byteTime = now;
+
+    return expired;
+}
+
+template <class Policy>
+bool BasicTinyLinkDecoder<Policy>::setChunkCallback(tinylink_chunk_callback_t callback, void* context)
+{
+    // Chunks are stored after the header, so a buffer without room for at
+    // least one payload byte cannot hold them.
+    if (callback != NULL && this->length <= LEN_HEADER) {
+        return false;
+    }
+
+    this->reset();
+
+    this->chunkCallback = callback;
+    this->chunkContext = context;
+
+    return true;
+}
+
+template <class Policy>
+void BasicTinyLinkDecoder<Policy>::deliverChunk(tinylink_chunk_e event)
+{
+    chunk_t chunk;
+
+    chunk.flags = this->frameFlags;
+    chunk.length = this->frameLength;
+    chunk.offset = 0;
+    chunk.size = 0;
+    chunk.data = this->payload;
+
+    // The frame has ended for the other events, so there is no data.
+    if (event == CHUNK_DATA) {
+        chunk.offset = static_cast<uint16_t>(this->index - LEN_HEADER - this->payloadIndex);
+        chunk.size = static_cast<uint16_t>(this->payloadIndex);
+    }
+
+    this->chunkCallback(event, &chunk, this->chunkContext);
+}
+
+template <class Policy>
+void BasicTinyLinkDecoder<Policy>::setDestination(void* buffer, uint16_t length)
+{
+    this->reset();
+
+    this->destination = static_cast<uint8_t*>(buffer);
+    this->destinationLength = length;
+}
+
+template <class Policy>
+void BasicTinyLinkDecoder<Policy>::setDestinationCallback(tinylink_destination_callback_t callback, void* context)
+{
+    this->reset();
+
+    this->destinationCallback = callback;
+    this->destinationContext = context;
+}
+
+template <class Policy>
+void BasicTinyLinkDecoder<Policy>::setMaxLength(uint16_t length)
+{
+    this->maxLength = length;
+}
+
+template <class Policy>
+uint8_t* BasicTinyLinkDecoder<Policy>::selectPayload(uint16_t flags, uint16_t length)
+{
+    if (length > this->maxLength) {
+        return NULL;
+    }
+
+    // When receiving in chunks, the payload does not have to fit in the
+    // buffer. Chunks are collected after the header.
+    if (this->chunkCallback != NULL) {
+        return &this->buffer[LEN_HEADER];
+    }
+
+    // Decode directly into a destination provided by the application.
+    if (this->destinationCallback != NULL) {
+        uint8_t* destination = this->destinationCallback(flags, length, this->destinationContext);
+
+        if (destination != NULL) {
+            return destination;
+        }
+    }
+    else if (this->destination != NULL) {
+        return length <= this->destinationLength ? this->destination : NULL;
+    }
+
+    // Decode into the buffer.
+    if (static_cast<size_t>(LEN_HEADER + length + LEN_BODY + 1) <= this->length) {
+        return &this->buffer[LEN_HEADER];
+    }
+
+    return NULL;
+}
+
+template <class Policy>
+void BasicTinyLinkDecoder<Policy>::discardPayload()
+{
+    // Clear the payload written to a destination provided by the application,
+    // so it never holds a partial or corrupted frame.
+    if (this->payload != NULL && this->payload != &this->buffer[LEN_HEADER]) {
+        memset(this->payload, 0, this->frameLength);
+    }
+}
+
+template <class Policy>
+bool BasicTinyLinkDecoder<Policy>::process(uint8_t byte, frame_t* frame)
+{
+    // Keep the bytes after the preamble, so they can be scanned again, and
+    // the bytes after the mark, while they may complete a preamble that
+    // starts before it.
+    if (this->resync != NULL && (this->state != WAITING_FOR_PREAMBLE || this->resyncMarked)) {
+        if (this->resyncLength < this->resyncSize) {
+            this->resync[this->resyncLength++] = byte;
+
+            if (this->state == WAITING_FOR_PREAMBLE) {
+                return this->replay(frame);
+            }
+
+            this->resyncIndex = this->resyncLength;
+        }
+        else {
+            this->resyncOverflow = true;
+        }
+    }
+
+    return this->step(byte, frame);
+}
+
+template <class Policy>
+size_t BasicTinyLinkDecoder<Policy>::receive(const uint8_t* data, size_t length)
+{
+    // Receive a span of the payload at once, as far as its bytes decode to
+    // themselves. Everything else is processed byte by byte.
+    size_t offset = this->index - LEN_HEADER;
+
+    if (offset >= this->frameLength) {
+        return 0;
+    }
+
+    size_t count = this->frameLength - offset;
+
+    if (this->chunkCallback != NULL && count > this->length - LEN_HEADER - this->payloadIndex) {
+        count = this->length - LEN_HEADER - this->payloadIndex;
+    }
+
+    if (count > length) {
+        count = length;
+    }
+
+    // Keep the bytes after the preamble, like `process`. A frame found by
+    // scanning again stops where the buffer is full, so it can be abandoned.
+    if (this->resync != NULL) {
+        size_t room = this->resyncSize - this->resyncLength;
+
+        if (this->resyncMarked && count > room) {
+            count = room;
+        }
+
+        count = this->policy.literal(data, count);
+
+        if (count > room) {
+            this->resyncOverflow = true;
+        }
+
+        memcpy(&this->resync[this->resyncLength], data, count < room ? count : room);
+
+        this->resyncLength += count < room ? count : room;
+        this->resyncIndex = this->resyncLength;
+    }
+    else {
+        count = this->policy.literal(data, count);
+    }
+
+    if (count == 0) {
+        return 0;
+    }
+
+    this->position += count;
+    this->index += count;
+
+    this->checksum = CRC32(this->checksum, data, count);
+
+    memcpy(&this->payload[this->payloadIndex], data, count);
+    this->payloadIndex += count;
+
+    if (this->chunkCallback != NULL) {
+        if (this->payloadIndex == this->length - LEN_HEADER || offset + count == this->frameLength) {
+            this->deliverChunk(CHUNK_DATA);
+            this->payloadIndex = 0;
+        }
+    }
+
+    return count;
+}
+
+template <class Policy>
+bool BasicTinyLinkDecoder<Policy>::step(uint8_t byte, frame_t* frame)
+{
+    this->position++;
+
+    // Decode the header and body according to the framing policy.
+    if (this->state == WAITING_FOR_HEADER || this->state == WAITING_FOR_BODY) {
+        tinylink_decode_e result = this->policy.decode(&byte);
+
+        if (result == DECODE_SKIP) {
+            return false;
+        }
+        else if (result == DECODE_INVALID) {
+            // The byte cannot be part of a frame, but may be part of the
+            // preamble of the next one, together with the bytes before it.
+            uint32_t history = this->policy.getHistory();
+
+            this->restart();
+
+            // This byte is scanned again, if backtracking. Without scanning
+            // again, decoding would have continued with this byte.
+            if (this->backtrack(this->resyncIndex - 1, history)) {
+                return false;
+            }
+
+            this->window = history;
+            this->skip(LEN_PREAMBLE - 1);
+        }
+    }
+
+    // Decide what to do.
+    switch (this->state) {
+        case WAITING_FOR_PREAMBLE:
+        {
+            // The preamble is detected using a shift register, so the buffer
+            // is not touched.
+            this->window = (this->window >> 8) | (static_cast<uint32_t>(byte) << 24);
+
+            if (this->window == PREAMBLE) {
+                this->synchronize();
+            }
+            else {
+                this->skip(1);
+            }
+
+            break;
+        }
+        case WAITING_FOR_HEADER:
+        {
+            this->buffer[this->index++] = byte;
+            this->checksum = CRC32(this->checksum, byte);
+
+            if (this->index == LEN_HEADER) {
+                uint16_t flags = _read_uint16_t(&this->buffer[0]);
+                uint16_t length = _read_uint16_t(&this->buffer[2]);
+                uint8_t checksumHeader = _read_uint8_t(&this->buffer[4]);
+
+                uint8_t* payload = NULL;
+
+                if (checksumHeader == _checksum_header(flags, length)) {
+                    payload = this->selectPayload(flags, length);
+
+                    if (payload == NULL) {
+                        TINYLINK_STATS_ADD(lengthRejects, 1);
+                    }
+                } else {
+                    TINYLINK_STATS_ADD(headerRejects, 1);
+                }
+
+                if (payload != NULL) {
+                    this->state = WAITING_FOR_BODY;
+                    this->frameFlags = flags;
+                    this->frameLength = length;
+                    this->payload = payload;
+                    this->payloadIndex = 0;
+                } else {
+                    TINYLINK_TRACE_EVENT(TRACE_DECODE_END);
+
+                    // Reset to start state.
+                    this->state = WAITING_FOR_PREAMBLE;
+                    this->index = 0;
+
+                    this->backtrack(this->resyncIndex, 0);
+                }
+            }
+
+            break;
+        }
+        case WAITING_FOR_BODY:
+        {
+            size_t offset = this->index++ - LEN_HEADER;
+
+            if (offset < this->frameLength) {
+                // The checksum is updated for every byte of the payload, so
+                // only the received checksum remains to be compared at the end.
+                this->checksum = CRC32(this->checksum, byte);
+                this->payload[this->payloadIndex++] = byte;
+
+                // Deliver a chunk when the buffer is full, or when the payload
+                // is complete.
+                if (this->chunkCallback != NULL) {
+                    if (this->payloadIndex == this->length - LEN_HEADER || offset + 1 == this->frameLength) {
+                        this->deliverChunk(CHUNK_DATA);
+                        this->payloadIndex = 0;
+                    }
+                }
+
+                break;
+            }
+
+            this->trailer[offset - this->frameLength] = byte;
+
+            if (offset + 1 == static_cast<size_t>(this->frameLength + LEN_CRC)) {
+                uint32_t checksumFrame = _read_uint32_t(this->trailer);
+                bool valid = checksumFrame == this->checksum;
+
+                TINYLINK_STATS_ADD(framesIn, valid ? 1 : 0);
+                TINYLINK_STATS_ADD(crcFailures, valid ? 0 : 1);
+                TINYLINK_TRACE_EVENT(TRACE_DECODE_END);
+
+                // Reset to start state.
+                this->state = WAITING_FOR_PREAMBLE;
+                this->index = 0;
+
+                if (!valid) {
+                    if (this->chunkCallback != NULL) {
+                        this->deliverChunk(CHUNK_INVALID);
+                    }
+                    else {
+                        this->discardPayload();
+                    }
+
+                    this->backtrack(this->resyncIndex, 0);
+                    break;
+                }
+
+                this->trim();
+
+                if (this->chunkCallback != NULL) {
+                    this->deliverChunk(CHUNK_VALID);
+                }
+                else {
+                    // Copy to frame.
+                    frame->flags = this->frameFlags;
+                    frame->length = this->frameLength;
+                    frame->payload = this->payload;
+
+                    return true;
+                }
+            }
+
+            break;
+        }
+    }
+
+    // No frames processed.
+    return false;
+}
+
+#if TINYLINK_STATS
+template <class Policy>
+const tinylink_stats_t& BasicTinyLinkDecoder<Policy>::getStats() const
+{
+    return this->stats;
+}
+
+template <class Policy>
+void BasicTinyLinkDecoder<Policy>::resetStats()
+{
+    memset(&this->stats, 0, sizeof(this->stats));
+}
+#endif
+
+#if TINYLINK_TRACE
+template <class Policy>
+void BasicTinyLinkDecoder<Policy>::setTraceCallback(tinylink_trace_callback_t callback, void* context)
+{
+    this->traceCallback = callback;
+    this->traceContext = context;
+}
+#endif
+
+template class BasicTinyLinkDecoder<TinyLinkStuffingPolicy>;
+template class BasicTinyLinkDecoder<TinyLinkCobsPolicy>;
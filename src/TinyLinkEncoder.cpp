@@ -0,0 +1,174 @@
+#include "TinyLinkEncoder.h"
+#include "Crc.h"
+#include "Utils.h"
+
+#include <string.h>
+
+template <class Sink>
+static bool _stuff(const uint8_t* data, const size_t length, uint32_t* checksum, const Sink& sink)
+{
+    return _write_spans(data, length, checksum, [&sink](const uint8_t* span, size_t size) -> bool {
+        const uint8_t* last = span + size;
+
+        while (span < last) {
+            // Pass the run of bytes that do not need escaping at once.
+            const uint8_t* escape = _find_escape(span, last);
+
+            if (escape > span && !sink(span, static_cast<size_t>(escape - span))) {
+                return false;
+            }
+
+            if (escape == last) {
+                break;
+            }
+
+            const uint8_t escaped[2] = {ESCAPE, *escape};
+
+            if (!sink(escaped, sizeof(escaped))) {
+                return false;
+            }
+
+            span = escape + 1;
+        }
+
+        return true;
+    });
+}
+
+static uint8_t* _stuff(const uint8_t* data, const size_t length, uint8_t* buffer, const uint8_t* end, uint32_t* checksum)
+{
+    bool fits = _stuff(data, length, checksum, [&buffer, end](const uint8_t* run, size_t size) -> bool {
+        if (size > static_cast<size_t>(end - buffer)) {
+            return false;
+        }
+
+        memcpy(buffer, run, size);
+        buffer += size;
+
+        return true;
+    });
+
+    return fits ? buffer : NULL;
+}
+
+static void _stuff(const uint8_t* data, const size_t length, tinylink_write_callback_t callback, void* context, uint32_t* checksum)
+{
+    _stuff(data, length, checksum, [callback, context](const uint8_t* run, size_t size) -> bool {
+        callback(run, size, context);
+        return true;
+    });
+}
+
+static size_t _count_escapes(const uint8_t* data, const size_t length)
+{
+    const uint8_t* last = data + length;
+    size_t count = 0;
+
+    while ((data = _find_escape(data, last)) < last) {
+        count++;
+        data++;
+    }
+
+    return count;
+}
+
+size_t TinyLinkEncoder::encodedLength(const frame_t* frame)
+{
+    uint8_t header[LEN_HEADER];
+    uint8_t trailer[LEN_CRC];
+
+    _write_header(header, frame->flags, frame->length);
+    _write_uint32_t(trailer, CRC32(CRC32(header, LEN_HEADER), frame->payload, frame->length));
+
+    return LEN_PREAMBLE + LEN_HEADER + frame->length + LEN_CRC +
+        _count_escapes(header, LEN_HEADER) +
+        _count_escapes(frame->payload, frame->length) +
+        _count_escapes(trailer, LEN_CRC);
+}
+
+size_t TinyLinkEncoder::encode(const frame_t* frame, uint8_t* buffer, size_t length)
+{
+    const uint8_t* end = buffer + length;
+
+    if (length < LEN_PREAMBLE) {
+        return 0;
+    }
+
+    // Preamble.
+    _write_uint32_t(buffer, PREAMBLE);
+
+    // Header.
+    uint8_t header[LEN_HEADER];
+    uint32_t checksum = 0;
+
+    _write_header(header, frame->flags, frame->length);
+
+    uint8_t* position = _stuff(header, LEN_HEADER, buffer + LEN_PREAMBLE, end, &checksum);
+
+    if (!position) {
+        return 0;
+    }
+
+    // Body. The checksum is updated while encoding.
+    position = _stuff(frame->payload, frame->length, position, end, &checksum);
+
+    if (!position) {
+        return 0;
+    }
+
+    uint8_t trailer[LEN_CRC];
+
+    _write_uint32_t(trailer, checksum);
+
+    position = _stuff(trailer, LEN_CRC, position, end, NULL);
+
+    if (!position) {
+        return 0;
+    }
+
+    return position - buffer;
+}
+
+void TinyLinkEncoder::encode(const frame_t* frame, tinylink_write_callback_t callback, void* context)
+{
+    // Preamble.
+    uint8_t preamble[LEN_PREAMBLE];
+
+    _write_uint32_t(preamble, PREAMBLE);
+    callback(preamble, LEN_PREAMBLE, context);
+
+    // Header.
+    uint8_t header[LEN_HEADER];
+    uint32_t checksum = 0;
+
+    _write_header(header, frame->flags, frame->length);
+    _stuff(header, LEN_HEADER, callback, context, &checksum);
+
+    // Body. The checksum is updated while encoding.
+    _stuff(frame->payload, frame->length, callback, context, &checksum);
+
+    uint8_t trailer[LEN_CRC];
+
+    _write_uint32_t(trailer, checksum);
+    _stuff(trailer, LEN_CRC, callback, context, NULL);
+}
+
+size_t TinyLinkEncoder::encode(const frame_t* frames, size_t count, uint8_t* buffer, size_t length, size_t* encoded)
+{
+    size_t offset = 0;
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        size_t written = TinyLinkEncoder::encode(&frames[i], buffer + offset, length - offset);
+
+        if (written == 0) {
+            break;
+        }
+
+        offset += written;
+    }
+
+    *encoded = i;
+
+    return offset;
+}
@@ -0,0 +1,359 @@
+#include "TinyLinkGateway.h"
+
+#ifdef TINYLINK_HAS_GATEWAY
+
+#include "TinyLinkEncoder.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Maximum number of events handled per call to `poll`.
+#define GATEWAY_EVENTS 64
+
+TinyLinkGateway::TinyLinkGateway(size_t _links, size_t _length, tinylink_gateway_callback_t _callback, void* _context)
+{
+    this->epoll = epoll_create1(EPOLL_CLOEXEC);
+    this->wakeup = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+    // The wakeup is the only event without a link.
+    if (this->epoll >= 0 && this->wakeup >= 0) {
+        struct epoll_event event;
+
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.ptr = NULL;
+
+        epoll_ctl(this->epoll, EPOLL_CTL_ADD, this->wakeup, &event);
+    }
+
+    this->links = new link_t[_links];
+    this->count = _links;
+    this->length = _length;
+
+    this->callback = _callback;
+    this->context = _context;
+
+    for (size_t i = 0; i < _links; i++) {
+        link_t* link = &this->links[i];
+
+        link->gateway = this;
+        link->index = i;
+
+        link->fd = -1;
+        link->socket = false;
+        link->open = false;
+        link->waiting = false;
+
+        link->decoder = NULL;
+        link->buffer = NULL;
+
+        link->pending = NULL;
+        link->pendingOffset = 0;
+        link->pendingLength = 0;
+
+        link->frames = 0;
+    }
+}
+
+TinyLinkGateway::~TinyLinkGateway()
+{
+    for (size_t i = 0; i < this->count; i++) {
+        this->remove(i);
+    }
+
+    delete[] this->links;
+
+    if (this->epoll >= 0) {
+        ::close(this->epoll);
+    }
+
+    if (this->wakeup >= 0) {
+        ::close(this->wakeup);
+    }
+}
+
+int TinyLinkGateway::add(int fd)
+{
+    if (this->epoll < 0) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < this->count; i++) {
+        link_t* link = &this->links[i];
+
+        if (link->fd >= 0) {
+            continue;
+        }
+
+        int flags = fcntl(fd, F_GETFL);
+
+        if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+            return -1;
+        }
+
+        struct stat status;
+
+        if (fstat(fd, &status) < 0) {
+            return -1;
+        }
+
+        struct epoll_event event;
+
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.ptr = link;
+
+        if (epoll_ctl(this->epoll, EPOLL_CTL_ADD, fd, &event) < 0) {
+            return -1;
+        }
+
+        link->fd = fd;
+        link->socket = S_ISSOCK(status.st_mode);
+        link->open = true;
+        link->waiting = false;
+
+        link->buffer = new uint8_t[this->length];
+        link->decoder = new TinyLinkDecoder(link->buffer, this->length);
+
+        link->pending = new uint8_t[TINYLINK_GATEWAY_WRITE_SIZE];
+        link->pendingOffset = 0;
+        link->pendingLength = 0;
+
+        return static_cast<int>(i);
+    }
+
+    return -1;
+}
+
+void TinyLinkGateway::remove(size_t link)
+{
+    link_t* l = &this->links[link];
+
+    if (l->fd < 0) {
+        return;
+    }
+
+    this->close(l);
+
+    delete l->decoder;
+    delete[] l->buffer;
+    delete[] l->pending;
+
+    l->fd = -1;
+    l->decoder = NULL;
+    l->buffer = NULL;
+    l->pending = NULL;
+    l->pendingOffset = 0;
+    l->pendingLength = 0;
+}
+
+bool TinyLinkGateway::write(size_t link, const frame_t* frame)
+{
+    link_t* l = &this->links[link];
+
+    if (!l->open) {
+        return false;
+    }
+
+    // Make room at the end of the buffer.
+    if (l->pendingOffset > 0) {
+        memmove(l->pending, &l->pending[l->pendingOffset], l->pendingLength - l->pendingOffset);
+
+        l->pendingLength -= l->pendingOffset;
+        l->pendingOffset = 0;
+    }
+
+    size_t encoded = TinyLinkEncoder::encode(
+        frame, &l->pending[l->pendingLength], TINYLINK_GATEWAY_WRITE_SIZE - l->pendingLength);
+
+    if (encoded == 0) {
+        return false;
+    }
+
+    l->pendingLength += encoded;
+
+    if (!l->waiting) {
+        this->flush(l);
+    }
+
+    // Writing may have found the link closed.
+    return l->open;
+}
+
+bool TinyLinkGateway::write(size_t link, const uint16_t flags, const void* payload, const uint16_t length)
+{
+    frame_t frame;
+
+    frame.length = length;
+    frame.flags = flags;
+    frame.payload = static_cast<const uint8_t*>(payload);
+
+    return this->write(link, &frame);
+}
+
+int TinyLinkGateway::poll(int timeout)
+{
+    struct epoll_event events[GATEWAY_EVENTS];
+
+    int ready = epoll_wait(this->epoll, events, GATEWAY_EVENTS, timeout);
+
+    if (ready < 0) {
+        return errno == EINTR ? 0 : -1;
+    }
+
+    int frames = 0;
+
+    for (int i = 0; i < ready; i++) {
+        link_t* link = static_cast<link_t*>(events[i].data.ptr);
+
+        if (link == NULL) {
+            uint64_t value;
+
+            if (::read(this->wakeup, &value, sizeof(value)) < 0) {
+                // Already reset by another wakeup.
+            }
+
+            continue;
+        }
+
+        if (events[i].events & EPOLLOUT) {
+            this->flush(link);
+        }
+
+        if (link->open && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+            link->frames = 0;
+
+            this->read(link);
+
+            frames += static_cast<int>(link->frames);
+        }
+    }
+
+    return frames;
+}
+
+void TinyLinkGateway::wake()
+{
+    const uint64_t value = 1;
+
+    if (::write(this->wakeup, &value, sizeof(value)) < 0) {
+        // The counter is saturated, so a wakeup is pending anyway.
+    }
+}
+
+bool TinyLinkGateway::isOpen(size_t link) const
+{
+    return this->links[link].open;
+}
+
+size_t TinyLinkGateway::getPending(size_t link) const
+{
+    return this->links[link].pendingLength - this->links[link].pendingOffset;
+}
+
+int TinyLinkGateway::getFd() const
+{
+    return this->epoll;
+}
+
+void TinyLinkGateway::receive(const frame_t* frame, void* context)
+{
+    link_t* link = static_cast<link_t*>(context);
+
+    link->frames++;
+    link->gateway->callback(link->index, frame, link->gateway->context);
+}
+
+void TinyLinkGateway::read(link_t* link)
+{
+    // Read one block per event. Epoll is level-triggered, so remaining bytes
+    // are read in the next call, after the other links had their turn.
+    ssize_t length = ::read(link->fd, this->block, sizeof(this->block));
+
+    if (length > 0) {
+        link->decoder->feed(this->block, static_cast<size_t>(length), &TinyLinkGateway::receive, link);
+    }
+    else if (length == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+        this->hangup(link);
+    }
+}
+
+void TinyLinkGateway::flush(link_t* link)
+{
+    while (link->pendingOffset < link->pendingLength) {
+        const uint8_t* data = &link->pending[link->pendingOffset];
+        size_t length = link->pendingLength - link->pendingOffset;
+
+        // Writing to a socket whose peer is gone must fail with `EPIPE`,
+        // instead of raising `SIGPIPE` for the whole process.
+        ssize_t written = link->socket ? ::send(link->fd, data, length, MSG_NOSIGNAL) : ::write(link->fd, data, length);
+
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                // The other side is gone, such as with `EPIPE`.
+                link->pendingOffset = link->pendingLength = 0;
+
+                this->hangup(link);
+                return;
+            }
+
+            // Continue when the file descriptor is writable again.
+            this->watch(link, true);
+            return;
+        }
+
+        link->pendingOffset += static_cast<size_t>(written);
+    }
+
+    link->pendingOffset = link->pendingLength = 0;
+
+    this->watch(link, false);
+}
+
+void TinyLinkGateway::close(link_t* link)
+{
+    if (link->open) {
+        epoll_ctl(this->epoll, EPOLL_CTL_DEL, link->fd, NULL);
+
+        link->open = false;
+        link->waiting = false;
+    }
+}
+
+void TinyLinkGateway::hangup(link_t* link)
+{
+    // Only report the first failure, whether reading or writing.
+    if (link->open) {
+        this->close(link);
+        this->callback(link->index, NULL, this->context);
+    }
+}
+
+void TinyLinkGateway::watch(link_t* link, bool writable)
+{
+    if (!link->open || link->waiting == writable) {
+        return;
+    }
+
+    struct epoll_event event;
+
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN | (writable ? static_cast<uint32_t>(EPOLLOUT) : 0);
+    event.data.ptr = link;
+
+    epoll_ctl(this->epoll, EPOLL_CTL_MOD, link->fd, &event);
+
+    link->waiting = writable;
+}
+
+#endif
@@ -0,0 +1,413 @@
+#include "TinyLinkShardedGateway.h"
+
+#ifdef TINYLINK_HAS_GATEWAY
+
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+// Timeout of a worker thread waiting for events, which bounds the time it
+// takes to stop.
+#define SHARD_POLL_TIMEOUT 10
+
+TinyLinkShardedGateway::TinyLinkShardedGateway(size_t _threads, size_t _links, size_t _length, size_t _slots)
+{
+    this->shards = new shard_t[_threads];
+    this->threads = _threads;
+    this->links = _links;
+    this->length = _length;
+
+    // Positions are mapped to slots with a mask.
+    size_t slots = 1;
+
+    while (slots < _slots) {
+        slots <<= 1;
+    }
+
+    for (size_t i = 0; i < _threads; i++) {
+        shard_t* shard = &this->shards[i];
+
+        shard->owner = this;
+        shard->index = i;
+
+        shard->gateway = new TinyLinkGateway(_links, _length, &TinyLinkShardedGateway::receive, shard);
+        shard->links = 0;
+
+        TinyLinkShardedGateway::create(&shard->received, slots, _length);
+        TinyLinkShardedGateway::create(&shard->commands, slots, _length);
+
+        shard->space = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        shard->waiting.store(false, std::memory_order_relaxed);
+
+        shard->drops.store(0, std::memory_order_relaxed);
+        shard->writeDrops.store(0, std::memory_order_relaxed);
+    }
+
+    this->current = 0;
+    this->next = 0;
+    this->holding = false;
+
+    this->running.store(false, std::memory_order_relaxed);
+}
+
+TinyLinkShardedGateway::~TinyLinkShardedGateway()
+{
+    this->stop();
+
+    for (size_t i = 0; i < this->threads; i++) {
+        delete this->shards[i].gateway;
+
+        TinyLinkShardedGateway::destroy(&this->shards[i].received);
+        TinyLinkShardedGateway::destroy(&this->shards[i].commands);
+
+        if (this->shards[i].space >= 0) {
+            ::close(this->shards[i].space);
+        }
+    }
+
+    delete[] this->shards;
+}
+
+int TinyLinkShardedGateway::add(int fd)
+{
+    if (this->running.load(std::memory_order_relaxed)) {
+        return -1;
+    }
+
+    shard_t* shard = NULL;
+
+    for (size_t i = 0; i < this->threads; i++) {
+        if (shard == NULL || this->shards[i].links < shard->links) {
+            shard = &this->shards[i];
+        }
+    }
+
+    if (shard == NULL) {
+        return -1;
+    }
+
+    int link = shard->gateway->add(fd);
+
+    if (link < 0) {
+        return -1;
+    }
+
+    shard->links++;
+
+    return static_cast<int>(shard->index * this->links + static_cast<size_t>(link));
+}
+
+bool TinyLinkShardedGateway::start()
+{
+    if (this->running.exchange(true)) {
+        return false;
+    }
+
+    unsigned int cpus = std::thread::hardware_concurrency();
+
+    for (size_t i = 0; i < this->threads; i++) {
+        shard_t* shard = &this->shards[i];
+
+        shard->thread = std::thread(&TinyLinkShardedGateway::run, this, shard);
+
+        // Pinning is best effort.
+        if (cpus > 0) {
+            cpu_set_t set;
+
+            CPU_ZERO(&set);
+            CPU_SET(i % cpus, &set);
+
+            pthread_setaffinity_np(shard->thread.native_handle(), sizeof(set), &set);
+        }
+    }
+
+    return true;
+}
+
+void TinyLinkShardedGateway::stop()
+{
+    if (!this->running.exchange(false)) {
+        return;
+    }
+
+    // Worker threads waiting for room notice immediately.
+    for (size_t i = 0; i < this->threads; i++) {
+        TinyLinkShardedGateway::notify(&this->shards[i]);
+    }
+
+    for (size_t i = 0; i < this->threads; i++) {
+        this->shards[i].thread.join();
+    }
+}
+
+bool TinyLinkShardedGateway::read(size_t* link, frame_t* frame)
+{
+    // Release the slot of the previous frame to its worker thread.
+    if (this->holding) {
+        shard_t* shard = &this->shards[this->current];
+
+        TinyLinkShardedGateway::release(&shard->received);
+        this->holding = false;
+
+        // Pairs with the fence in `wait`, so either the worker thread sees the
+        // freed slot, or this thread sees that it is waiting. It is woken once
+        // half of the queue is free, so it can fill the queue in one go
+        // instead of waking up for every slot.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (shard->waiting.load(std::memory_order_relaxed)) {
+            ring_t* ring = &shard->received;
+            size_t used = ring->head.load(std::memory_order_relaxed) - ring->tail.load(std::memory_order_relaxed);
+
+            if (used <= ring->mask / 2 && shard->waiting.exchange(false, std::memory_order_relaxed)) {
+                TinyLinkShardedGateway::notify(shard);
+            }
+        }
+    }
+
+    // Start at the queue after the one read last, so that a busy worker
+    // thread cannot starve the others.
+    for (size_t i = 0; i < this->threads; i++) {
+        size_t index = (this->next + i) % this->threads;
+        slot_t* slot = TinyLinkShardedGateway::peek(&this->shards[index].received);
+
+        if (slot == NULL) {
+            continue;
+        }
+
+        *link = slot->link;
+
+        frame->flags = slot->flags;
+        frame->length = slot->length;
+        frame->payload = slot->closed ? NULL : slot->payload;
+
+        this->current = index;
+        this->next = index + 1;
+        this->holding = true;
+
+        return true;
+    }
+
+    return false;
+}
+
+bool TinyLinkShardedGateway::write(size_t link, const frame_t* frame)
+{
+    size_t index = link / this->links;
+
+    if (index >= this->threads || frame->length > this->length) {
+        return false;
+    }
+
+    shard_t* shard = &this->shards[index];
+    slot_t* slot = TinyLinkShardedGateway::claim(&shard->commands);
+
+    if (slot == NULL) {
+        return false;
+    }
+
+    slot->link = link % this->links;
+    slot->flags = frame->flags;
+    slot->length = frame->length;
+    slot->closed = false;
+
+    memcpy(slot->payload, frame->payload, frame->length);
+
+    TinyLinkShardedGateway::publish(&shard->commands);
+
+    shard->gateway->wake();
+
+    return true;
+}
+
+bool TinyLinkShardedGateway::write(size_t link, const uint16_t flags, const void* payload, const uint16_t length)
+{
+    frame_t frame;
+
+    frame.length = length;
+    frame.flags = flags;
+    frame.payload = static_cast<const uint8_t*>(payload);
+
+    return this->write(link, &frame);
+}
+
+uint32_t TinyLinkShardedGateway::getDrops() const
+{
+    uint32_t drops = 0;
+
+    for (size_t i = 0; i < this->threads; i++) {
+        drops += this->shards[i].drops.load(std::memory_order_relaxed);
+    }
+
+    return drops;
+}
+
+uint32_t TinyLinkShardedGateway::getWriteDrops() const
+{
+    uint32_t drops = 0;
+
+    for (size_t i = 0; i < this->threads; i++) {
+        drops += this->shards[i].writeDrops.load(std::memory_order_relaxed);
+    }
+
+    return drops;
+}
+
+void TinyLinkShardedGateway::receive(size_t link, const frame_t* frame, void* context)
+{
+    shard_t* shard = static_cast<shard_t*>(context);
+    slot_t* slot;
+
+    // Wait for room instead of dropping. This blocks reading from the links
+    // of this worker thread until the consumer thread catches up.
+    while ((slot = TinyLinkShardedGateway::claim(&shard->received)) == NULL) {
+        if (!shard->owner->running.load(std::memory_order_acquire)) {
+            shard->drops.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        TinyLinkShardedGateway::wait(shard);
+    }
+
+    slot->link = shard->index * shard->owner->links + link;
+
+    if (frame != NULL) {
+        slot->flags = frame->flags;
+        slot->length = frame->length;
+        slot->closed = false;
+
+        memcpy(slot->payload, frame->payload, frame->length);
+    }
+    else {
+        slot->flags = 0;
+        slot->length = 0;
+        slot->closed = true;
+    }
+
+    TinyLinkShardedGateway::publish(&shard->received);
+}
+
+void TinyLinkShardedGateway::wait(shard_t* shard)
+{
+    // Announce the wait before checking for room again, so that a slot freed
+    // in between is not missed. The consumer thread clears the flag when it
+    // wakes this thread.
+    shard->waiting.store(true, std::memory_order_relaxed);
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (TinyLinkShardedGateway::claim(&shard->received) == NULL) {
+        struct pollfd event;
+
+        event.fd = shard->space;
+        event.events = POLLIN;
+        event.revents = 0;
+
+        // The timeout bounds the time it takes to notice a stop, should the
+        // eventfd not be available, or the consumer thread stop reading before
+        // half of the queue is free.
+        if (::poll(&event, 1, SHARD_POLL_TIMEOUT) > 0) {
+            uint64_t value;
+
+            if (::read(shard->space, &value, sizeof(value)) < 0) {
+                // Already reset by another notification.
+            }
+        }
+    }
+
+    shard->waiting.store(false, std::memory_order_relaxed);
+}
+
+void TinyLinkShardedGateway::notify(shard_t* shard)
+{
+    const uint64_t value = 1;
+
+    if (::write(shard->space, &value, sizeof(value)) < 0) {
+        // The counter is saturated, so a notification is pending anyway.
+    }
+}
+
+void TinyLinkShardedGateway::create(ring_t* ring, size_t slots, size_t length)
+{
+    ring->slots = new slot_t[slots];
+    ring->mask = slots - 1;
+    ring->storage = new uint8_t[slots * length];
+
+    for (size_t i = 0; i < slots; i++) {
+        ring->slots[i].payload = &ring->storage[i * length];
+    }
+
+    ring->head.store(0, std::memory_order_relaxed);
+    ring->tail.store(0, std::memory_order_relaxed);
+}
+
+void TinyLinkShardedGateway::destroy(ring_t* ring)
+{
+    delete[] ring->slots;
+    delete[] ring->storage;
+}
+
+TinyLinkShardedGateway::slot_t* TinyLinkShardedGateway::claim(ring_t* ring)
+{
+    size_t head = ring->head.load(std::memory_order_relaxed);
+
+    if (head - ring->tail.load(std::memory_order_acquire) > ring->mask) {
+        return NULL;
+    }
+
+    return &ring->slots[head & ring->mask];
+}
+
+void TinyLinkShardedGateway::publish(ring_t* ring)
+{
+    ring->head.store(ring->head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+TinyLinkShardedGateway::slot_t* TinyLinkShardedGateway::peek(ring_t* ring)
+{
+    size_t tail = ring->tail.load(std::memory_order_relaxed);
+
+    if (ring->head.load(std::memory_order_acquire) == tail) {
+        return NULL;
+    }
+
+    return &ring->slots[tail & ring->mask];
+}
+
+void TinyLinkShardedGateway::release(ring_t* ring)
+{
+    ring->tail.store(ring->tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void TinyLinkShardedGateway::run(shard_t* shard)
+{
+    while (this->running.load(std::memory_order_acquire)) {
+        shard->gateway->poll(SHARD_POLL_TIMEOUT);
+
+        this->execute(shard);
+    }
+}
+
+void TinyLinkShardedGateway::execute(shard_t* shard)
+{
+    slot_t* slot;
+
+    while ((slot = TinyLinkShardedGateway::peek(&shard->commands)) != NULL) {
+        if (!shard->gateway->write(slot->link, slot->flags, slot->payload, slot->length)) {
+            // Retry when the write buffer of the link has drained. A frame
+            // that does not fit in an empty buffer never will.
+            if (shard->gateway->isOpen(slot->link) && shard->gateway->getPending(slot->link) > 0) {
+                return;
+            }
+
+            shard->writeDrops.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        TinyLinkShardedGateway::release(&shard->commands);
+    }
+}
+
+#endif
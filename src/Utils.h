@@ -0,0 +1,165 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include "Crc.h"
+#include "TinyLinkEncoder.h"
+#include "TinyLinkProtocol.h"
+#include "TinyLinkStats.h"
+
+static inline uint32_t _read_uint32_t(const uint8_t* buffer)
+{
+    uint32_t value = 0;
+
+    value |= static_cast<uint32_t>(buffer[0]) << 0;
+    value |= static_cast<uint32_t>(buffer[1]) << 8;
+    value |= static_cast<uint32_t>(buffer[2]) << 16;
+    value |= static_cast<uint32_t>(buffer[3]) << 24;
+
+    return value;
+}
+
+static inline void _write_uint32_t(uint8_t* buffer, uint32_t value)
+{
+    buffer[0] = (value & 0x000000FF) >> 0;
+    buffer[1] = (value & 0x0000FF00) >> 8;
+    buffer[2] = (value & 0x00FF0000) >> 16;
+    buffer[3] = (value & 0xFF000000) >> 24;
+}
+
+static inline uint16_t _read_uint16_t(const uint8_t* buffer)
+{
+    uint16_t value = 0;
+
+    value |= static_cast<uint16_t>(buffer[0]) << 0;
+    value |= static_cast<uint16_t>(buffer[1]) << 8;
+
+    return value;
+}
+
+static inline void _write_uint16_t(uint8_t* buffer, uint16_t value)
+{
+    buffer[0] = (value & 0x00FF) >> 0;
+    buffer[1] = (value & 0xFF00) >> 8;
+}
+
+static inline uint8_t _read_uint8_t(const uint8_t* buffer)
+{
+    uint8_t value = 0;
+
+    value |= static_cast<uint8_t>(buffer[0]) << 0;
+
+    return value;
+}
+
+static inline void _write_uint8_t(uint8_t* buffer, uint8_t value)
+{
+    buffer[0] = (value & 0xFF) >> 0;
+}
+
+static inline uint8_t _checksum_header(const uint16_t flags, const uint16_t length)
+{
+    uint8_t a = (flags  & 0x00FF) >> 0;
+    uint8_t b = (flags  & 0xFF00) >> 8;
+    uint8_t c = (length & 0x00FF) >> 0;
+    uint8_t d = (length & 0xFF00) >> 8;
+
+    return a ^ b ^ c ^ d;
+}
+
+static inline void _write_header(uint8_t* buffer, const uint16_t flags, const uint16_t length)
+{
+    _write_uint16_t(&buffer[0], flags);
+    _write_uint16_t(&buffer[2], length);
+    _write_uint8_t(&buffer[4], _checksum_header(flags, length));
+}
+
+static inline const uint8_t* _find_escape(const uint8_t* buffer, const uint8_t* end)
+{
+#if !defined(__AVR__)
+    // Test four bytes at a time whether one of them equals FLAG or ESCAPE. The
+    // expression (x - 0x01010101) & ~x & 0x80808080 is non-zero if and only if
+    // one of the bytes of x is zero.
+    while (end - buffer >= 4) {
+        uint32_t word;
+
+        memcpy(&word, buffer, sizeof(word));
+
+        uint32_t a = word ^ (0x01010101UL * FLAG);
+        uint32_t b = word ^ (0x01010101UL * ESCAPE);
+
+        if (((a - 0x01010101UL) & ~a & 0x80808080UL) || ((b - 0x01010101UL) & ~b & 0x80808080UL)) {
+            break;
+        }
+
+        buffer += 4;
+    }
+#endif
+
+    while (buffer < end && *buffer != FLAG && *buffer != ESCAPE) {
+        buffer++;
+    }
+
+    return buffer;
+}
+
+// Pass the data to `sink` span by span, updating the checksum (if given) of
+// every span first, so the data is read from memory only once. Stops when the
+// sink returns false.
+template <class Sink>
+static inline bool _write_spans(const uint8_t* data, const size_t length, uint32_t* checksum, const Sink& sink)
+{
+    const uint8_t* end = data + length;
+
+    while (data < end) {
+        const uint8_t* span = (end - data > TINYLINK_WRITE_SPAN_SIZE) ? data + TINYLINK_WRITE_SPAN_SIZE : end;
+
+        if (checksum) {
+            *checksum = CRC32(*checksum, data, span - data);
+        }
+
+        if (!sink(data, static_cast<size_t>(span - data))) {
+            return false;
+        }
+
+        data = span;
+    }
+
+    return true;
+}
+
+static inline uint32_t _shift_window(uint32_t window, const uint8_t* buffer, const uint8_t* end)
+{
+    // Only the last four bytes end up in the window. The most recent byte is
+    // shifted into the highest byte, so the window compares to the preamble
+    // as if it was read in little endian.
+    if (end - buffer > 4) {
+        buffer = end - 4;
+    }
+
+    while (buffer < end) {
+        window = (window >> 8) | (static_cast<uint32_t>(*buffer++) << 24);
+    }
+
+    return window;
+}
+
+// Update a counter of the statistics of `this`, if enabled.
+#if TINYLINK_STATS
+#define TINYLINK_STATS_ADD(counter, value) (this->stats.counter += (value))
+#else
+#define TINYLINK_STATS_ADD(counter, value) ((void) 0)
+#endif
+
+// Invoke the trace callback of `this`, if enabled.
+#if TINYLINK_TRACE
+#define TINYLINK_TRACE_EVENT(event) \
+    do { \
+        if (this->traceCallback != NULL) { \
+            this->traceCallback(event, this->traceContext); \
+        } \
+    } while (0)
+#else
+#define TINYLINK_TRACE_EVENT(event) ((void) 0)
+#endif
@@ -34,6 +34,12 @@ public:
         return written;
     }
 
+    /**
+     * @brief Get the number of bytes that can be written without blocking.
+     * @return The number of bytes (0 if unknown, like Arduino's Print).
+     */
+    virtual int availableForWrite() { return 0; }
+
     /**
      * @brief Get the number of bytes available to read.
      * @return The number of bytes available.
@@ -46,6 +52,24 @@ public:
      */
     virtual int read() = 0;
 
+    /**
+     * @brief Read multiple bytes from the stream.
+     * @param buffer Pointer to the buffer to read into.
+     * @param length The maximum number of bytes to read.
+     * @return The number of bytes read.
+     */
+    virtual size_t readBytes(uint8_t* buffer, size_t length) {
+        size_t count = 0;
+        while (count < length) {
+            int value = read();
+            if (value < 0) {
+                break;
+            }
+            buffer[count++] = static_cast<uint8_t>(value);
+        }
+        return count;
+    }
+
     /**
      * @brief Peek at the next byte without removing it.
      * @return The byte peeked, or -1 if no data available.
@@ -1,21 +1,51 @@
 #include <Crc.h>
 #include <Stream.h>
 #include <TinyLink.h>
+#include <TinyLinkAggregator.h>
+#include <TinyLinkCapture.h>
+#include <TinyLinkDecoder.h>
+#include <TinyLinkEncoder.h>
+#include <TinyLinkGateway.h>
+#include <TinyLinkPool.h>
+#include <TinyLinkQueue.h>
+#include <TinyLinkRing.h>
+#include <TinyLinkScheduler.h>
+#include <TinyLinkShardedGateway.h>
 #include <unity.h>
 
+#include <algorithm>
+#include <chrono>
 #include <queue>
+#include <thread>
 #include <vector>
 
+#ifdef TINYLINK_HAS_GATEWAY
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#ifdef TINYLINK_HAS_CAPTURE
+#include <stdio.h>
+#include <stdlib.h>
+#endif
+
 /**
  * @brief Simple stream that captures outgoing bytes and replays queued incoming bytes.
  */
 class MockStream : public Stream {
 public:
     size_t write(uint8_t b) override {
+        writes++;
         written.push_back(b);
         return 1;
     }
 
+    size_t write(const uint8_t* buffer, size_t size) override {
+        writes++;
+        written.insert(written.end(), buffer, buffer + size);
+        return size;
+    }
+
     int available() override { return static_cast<int>(incoming.size()); }
 
     int read() override {
@@ -36,6 +66,8 @@ public:
         return incoming.front();
     }
 
+    int availableForWrite() override { return space; }
+
     void flush() override {}
 
     void feed(const std::vector<uint8_t>& data) {
@@ -45,12 +77,74 @@ public:
     }
 
     std::vector<uint8_t> written;
+    size_t writes = 0;
+    int space = 0;
 
 private:
     std::queue<uint8_t> incoming;
 };
 
+/**
+ * @brief Encode a frame the straightforward way: byte by byte, with the CRC
+ * computed in a separate pass by the bitwise reference implementation.
+ */
+static std::vector<uint8_t> encodeReference(uint16_t flags, const std::vector<uint8_t>& payload) {
+    std::vector<uint8_t> result{0x55, 0xAA, 0x55, 0xAA};
+
+    const uint16_t length = static_cast<uint16_t>(payload.size());
+    const uint8_t header[] = {
+        static_cast<uint8_t>(flags >> 0),
+        static_cast<uint8_t>(flags >> 8),
+        static_cast<uint8_t>(length >> 0),
+        static_cast<uint8_t>(length >> 8),
+        static_cast<uint8_t>((flags >> 0) ^ (flags >> 8) ^ (length >> 0) ^ (length >> 8))
+    };
+
+    const uint32_t crc = CRC32Bitwise(CRC32Bitwise(0, header, sizeof(header)), payload.data(), payload.size());
+
+    std::vector<uint8_t> body(header, header + sizeof(header));
+    body.insert(body.end(), payload.begin(), payload.end());
+
+    for (size_t i = 0; i < 4; i++) {
+        body.push_back(static_cast<uint8_t>(crc >> (i * 8)));
+    }
+
+    for (uint8_t b : body) {
+        if (b == FLAG || b == ESCAPE) {
+            result.push_back(ESCAPE);
+        }
+
+        result.push_back(b);
+    }
+
+    return result;
+}
+
+/**
+ * @brief Generate a pseudo-random payload, where approximately one in
+ * `density` bytes needs escaping (zero means none).
+ */
+static std::vector<uint8_t> randomPayload(size_t length, uint32_t seed, uint32_t density) {
+    std::vector<uint8_t> result(length);
+
+    for (size_t i = 0; i < length; i++) {
+        seed = seed * 1103515245 + 12345;
+
+        uint8_t value = static_cast<uint8_t>(seed >> 16);
+
+        if (value == FLAG || value == ESCAPE) {
+            value = 0x00;
+        }
+
+        if (density > 0 && ((seed >> 8) % density) == 0) {
+            value = (seed & 0x100) ? FLAG : ESCAPE;
+        }
+
+        result[i] = value;
+    }
 
+    return result;
+}
 
 void test_constructor(void) {
     uint8_t buffer[256];
@@ -323,6 +417,2339 @@ void test_convenience_read_rejects_too_large(void) {
     TEST_ASSERT_FALSE(parsed);
 }
 
+void test_write_frame_matches_reference(void) {
+    uint8_t buffer[1024];
+
+    const size_t lengths[] = {0, 1, 3, 4, 5, 31, 32, 33, 100, 511, 512, 513, 1000};
+    const uint32_t densities[] = {0, 1, 2, 7, 50};
+
+    for (size_t length : lengths) {
+        for (uint32_t density : densities) {
+            MockStream stream;
+            TinyLink tinylink(stream, buffer, sizeof(buffer));
+
+            const std::vector<uint8_t> payload = randomPayload(length, static_cast<uint32_t>(length + density), density);
+            const std::vector<uint8_t> expected = encodeReference(0xAA1B, payload);
+
+            TEST_ASSERT_TRUE(tinylink.write(0xAA1B, payload.data(), static_cast<uint16_t>(payload.size())));
+            TEST_ASSERT_EQUAL_UINT32(expected.size(), stream.written.size());
+            TEST_ASSERT_EQUAL_UINT8_ARRAY(expected.data(), stream.written.data(), expected.size());
+        }
+    }
+}
+
+void test_write_frame_batches_writes(void) {
+    uint8_t buffer[256];
+    MockStream stream;
+    TinyLink tinylink(stream, buffer, sizeof(buffer));
+
+    // A small frame is written at once.
+    const std::vector<uint8_t> small = randomPayload(8, 1, 0);
+
+    TEST_ASSERT_TRUE(tinylink.write(0x0001, small.data(), static_cast<uint16_t>(small.size())));
+    TEST_ASSERT_EQUAL_UINT32(1, stream.writes);
+
+    // A large frame without escapes is written in three runs: preamble and
+    // header, payload and CRC.
+    const std::vector<uint8_t> large = randomPayload(200, 2, 0);
+
+    stream.writes = 0;
+
+    TEST_ASSERT_TRUE(tinylink.write(0x0001, large.data(), static_cast<uint16_t>(large.size())));
+    TEST_ASSERT_EQUAL_UINT32(3, stream.writes);
+}
+
+void test_read_frame_round_trip(void) {
+    uint8_t buffer[1100];
+
+    const size_t lengths[] = {0, 1, 5, 100, 1000};
+    const uint32_t densities[] = {0, 1, 7};
+
+    for (size_t length : lengths) {
+        for (uint32_t density : densities) {
+            MockStream stream;
+            TinyLink tinylink(stream, buffer, sizeof(buffer));
+
+            const std::vector<uint8_t> payload = randomPayload(length, static_cast<uint32_t>(length * density), density);
+            const std::vector<uint8_t> encoded = encodeReference(0x1BAA, payload);
+
+            stream.feed(encoded);
+
+            frame_t frame;
+            size_t frames = 0;
+
+            for (size_t i = 0; i < encoded.size(); i++) {
+                if (tinylink.readFrame(&frame)) {
+                    frames++;
+
+                    TEST_ASSERT_EQUAL_UINT32(encoded.size() - 1, i);
+                    TEST_ASSERT_EQUAL_UINT16(0x1BAA, frame.flags);
+                    TEST_ASSERT_EQUAL_UINT16(length, frame.length);
+
+                    if (length > 0) {
+                        TEST_ASSERT_EQUAL_UINT8_ARRAY(payload.data(), frame.payload, length);
+                    }
+                }
+            }
+
+            TEST_ASSERT_EQUAL_UINT32(1, frames);
+        }
+    }
+}
+
+void test_read_frame_rejects_invalid_crc(void) {
+    uint8_t buffer[64];
+    MockStream stream;
+    TinyLink tinylink(stream, buffer, sizeof(buffer));
+
+    const std::vector<uint8_t> payload = randomPayload(20, 3, 0);
+    std::vector<uint8_t> corrupted = encodeReference(0x0001, payload);
+    const std::vector<uint8_t> valid = encodeReference(0x0002, payload);
+
+    // Corrupt a payload byte, then feed a valid frame.
+    corrupted[LEN_PREAMBLE + LEN_HEADER + 4] ^= 0x01;
+
+    stream.feed(corrupted);
+    stream.feed(valid);
+
+    frame_t frame;
+    size_t frames = 0;
+
+    for (size_t i = 0; i < corrupted.size() + valid.size(); i++) {
+        if (tinylink.readFrame(&frame)) {
+            frames++;
+
+            TEST_ASSERT_EQUAL_UINT16(0x0002, frame.flags);
+        }
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(1, frames);
+}
+
+void test_read_frame_ignores_empty_stream(void) {
+    uint8_t buffer[64];
+    MockStream stream;
+    TinyLink tinylink(stream, buffer, sizeof(buffer));
+
+    const std::vector<uint8_t> encoded = encodeReference(0x0001, randomPayload(10, 4, 2));
+    const std::vector<uint8_t> first(encoded.begin(), encoded.begin() + 12);
+    const std::vector<uint8_t> second(encoded.begin() + 12, encoded.end());
+
+    frame_t frame;
+
+    // Reading from an empty stream in the middle of a frame must not affect
+    // the frame.
+    stream.feed(first);
+
+    for (size_t i = 0; i < first.size() + 10; i++) {
+        TEST_ASSERT_FALSE(tinylink.readFrame(&frame));
+    }
+
+    stream.feed(second);
+
+    bool parsed = false;
+
+    for (size_t i = 0; i < second.size(); i++) {
+        parsed = tinylink.readFrame(&frame);
+    }
+
+    TEST_ASSERT_TRUE(parsed);
+    TEST_ASSERT_EQUAL_UINT16(10, frame.length);
+}
+
+void test_poll_frame_reads_all_available(void) {
+    uint8_t buffer[128];
+    MockStream stream;
+    TinyLink tinylink(stream, buffer, sizeof(buffer));
+
+    frame_t frame;
+
+    TEST_ASSERT_FALSE(tinylink.pollFrame(&frame));
+
+    // Two frames, surrounded by junk.
+    stream.feed({0x01, 0x02, 0x55});
+    stream.feed(encodeReference(0x0001, randomPayload(50, 5, 3)));
+    stream.feed(encodeReference(0x0002, randomPayload(10, 6, 3)));
+    stream.feed({0x03, 0x04});
+
+    TEST_ASSERT_TRUE(tinylink.pollFrame(&frame));
+    TEST_ASSERT_EQUAL_UINT16(0x0001, frame.flags);
+    TEST_ASSERT_EQUAL_UINT16(50, frame.length);
+
+    TEST_ASSERT_TRUE(tinylink.pollFrame(&frame));
+    TEST_ASSERT_EQUAL_UINT16(0x0002, frame.flags);
+    TEST_ASSERT_EQUAL_UINT16(10, frame.length);
+
+    TEST_ASSERT_FALSE(tinylink.pollFrame(&frame));
+    TEST_ASSERT_EQUAL_INT(0, stream.available());
+
+    // A frame split across calls.
+    const std::vector<uint8_t> encoded = encodeReference(0x0003, randomPayload(40, 7, 3));
+
+    stream.feed(std::vector<uint8_t>(encoded.begin(), encoded.begin() + 20));
+    TEST_ASSERT_FALSE(tinylink.pollFrame(&frame));
+
+    stream.feed(std::vector<uint8_t>(encoded.begin() + 20, encoded.end()));
+    TEST_ASSERT_TRUE(tinylink.pollFrame(&frame));
+    TEST_ASSERT_EQUAL_UINT16(0x0003, frame.flags);
+}
+
+void test_poll_frame_leftover_used_by_read_frame(void) {
+    uint8_t buffer[128];
+    MockStream stream;
+    TinyLink tinylink(stream, buffer, sizeof(buffer));
+
+    const std::vector<uint8_t> first = encodeReference(0x0001, randomPayload(4, 8, 0));
+    const std::vector<uint8_t> second = encodeReference(0x0002, randomPayload(4, 9, 0));
+
+    stream.feed(first);
+    stream.feed(second);
+
+    frame_t frame;
+
+    TEST_ASSERT_TRUE(tinylink.pollFrame(&frame));
+    TEST_ASSERT_EQUAL_UINT16(0x0001, frame.flags);
+
+    // The second frame is (partially) buffered, and must be picked up by
+    // `readFrame` as well.
+    bool parsed = false;
+
+    for (size_t i = 0; i < second.size() && !parsed; i++) {
+        parsed = tinylink.readFrame(&frame);
+    }
+
+    TEST_ASSERT_TRUE(parsed);
+    TEST_ASSERT_EQUAL_UINT16(0x0002, frame.flags);
+}
+
+/**
+ * @brief Decoded frame, with a copy of the payload.
+ */
+struct DecodedFrame {
+    uint16_t flags;
+    std::vector<uint8_t> payload;
+};
+
+static void collectFrame(const frame_t* frame, void* context) {
+    std::vector<DecodedFrame>* frames = static_cast<std::vector<DecodedFrame>*>(context);
+
+    frames->push_back({frame->flags, std::vector<uint8_t>(frame->payload, frame->payload + frame->length)});
+}
+
+void test_decoder_feed_reports_all_frames(void) {
+    uint8_t buffer[256];
+    TinyLinkDecoder decoder(buffer, sizeof(buffer));
+
+    std::vector<uint8_t> data{0x00, 0xAA, 0x55};
+    std::vector<std::vector<uint8_t>> payloads;
+
+    for (uint16_t i = 0; i < 5; i++) {
+        payloads.push_back(randomPayload(i * 20, i, 3));
+
+        const std::vector<uint8_t> encoded = encodeReference(i, payloads.back());
+
+        data.insert(data.end(), encoded.begin(), encoded.end());
+    }
+
+    // Feed the data in spans of all sizes. Every span size must yield the
+    // same frames.
+    for (size_t span = 1; span <= data.size(); span += (span < 16 ? 1 : 37)) {
+        std::vector<DecodedFrame> frames;
+
+        decoder.reset();
+
+        for (size_t offset = 0; offset < data.size(); offset += span) {
+            const size_t length = (data.size() - offset) < span ? (data.size() - offset) : span;
+
+            decoder.feed(&data[offset], length, collectFrame, &frames);
+        }
+
+        TEST_ASSERT_EQUAL_UINT32(payloads.size(), frames.size());
+
+        for (size_t i = 0; i < frames.size(); i++) {
+            TEST_ASSERT_EQUAL_UINT16(i, frames[i].flags);
+            TEST_ASSERT_TRUE(payloads[i] == frames[i].payload);
+        }
+    }
+}
+
+void test_decoder_feed_stops_after_frame(void) {
+    uint8_t buffer[256];
+    TinyLinkDecoder decoder(buffer, sizeof(buffer));
+
+    const std::vector<uint8_t> first = encodeReference(0x0001, randomPayload(30, 1, 3));
+    const std::vector<uint8_t> second = encodeReference(0x0002, randomPayload(30, 2, 3));
+
+    std::vector<uint8_t> data(first);
+    data.insert(data.end(), second.begin(), second.end());
+
+    frame_t frame;
+    size_t consumed;
+
+    TEST_ASSERT_TRUE(decoder.feed(data.data(), data.size(), &consumed, &frame));
+    TEST_ASSERT_EQUAL_UINT32(first.size(), consumed);
+    TEST_ASSERT_EQUAL_UINT16(0x0001, frame.flags);
+
+    const size_t offset = consumed;
+
+    TEST_ASSERT_TRUE(decoder.feed(&data[offset], data.size() - offset, &consumed, &frame));
+    TEST_ASSERT_EQUAL_UINT32(second.size(), consumed);
+    TEST_ASSERT_EQUAL_UINT16(0x0002, frame.flags);
+
+    TEST_ASSERT_FALSE(decoder.feed(data.data(), LEN_PREAMBLE + 1, &consumed, &frame));
+    TEST_ASSERT_EQUAL_UINT32(LEN_PREAMBLE + 1, consumed);
+    TEST_ASSERT_EQUAL(WAITING_FOR_HEADER, decoder.getState());
+}
+
+void test_encoder_matches_reference(void) {
+    const size_t lengths[] = {0, 1, 5, 100, 1000};
+    const uint32_t densities[] = {0, 1, 7};
+
+    for (size_t length : lengths) {
+        for (uint32_t density : densities) {
+            const std::vector<uint8_t> payload = randomPayload(length, static_cast<uint32_t>(length + density), density);
+            const std::vector<uint8_t> expected = encodeReference(0x1B00, payload);
+
+            frame_t frame;
+            frame.flags = 0x1B00;
+            frame.length = static_cast<uint16_t>(length);
+            frame.payload = payload.data();
+
+            std::vector<uint8_t> buffer(TinyLinkEncoder::maxEncodedLength(length));
+
+            TEST_ASSERT_EQUAL_UINT32(expected.size(), TinyLinkEncoder::encodedLength(&frame));
+            TEST_ASSERT_EQUAL_UINT32(expected.size(), TinyLinkEncoder::encode(&frame, buffer.data(), buffer.size()));
+            TEST_ASSERT_EQUAL_UINT8_ARRAY(expected.data(), buffer.data(), expected.size());
+        }
+    }
+}
+
+void test_encoder_rejects_small_buffer(void) {
+    const std::vector<uint8_t> payload = randomPayload(40, 10, 3);
+    const std::vector<uint8_t> expected = encodeReference(0x0001, payload);
+
+    frame_t frame;
+    frame.flags = 0x0001;
+    frame.length = static_cast<uint16_t>(payload.size());
+    frame.payload = payload.data();
+
+    std::vector<uint8_t> buffer(expected.size());
+
+    for (size_t length = 0; length < expected.size(); length++) {
+        TEST_ASSERT_EQUAL_UINT32(0, TinyLinkEncoder::encode(&frame, buffer.data(), length));
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(expected.size(), TinyLinkEncoder::encode(&frame, buffer.data(), buffer.size()));
+}
+
+void test_encoder_encodes_batch(void) {
+    const std::vector<uint8_t> payload = randomPayload(40, 11, 3);
+
+    frame_t frames[3];
+    std::vector<uint8_t> expected;
+
+    for (uint16_t i = 0; i < 3; i++) {
+        frames[i].flags = i;
+        frames[i].length = static_cast<uint16_t>(payload.size());
+        frames[i].payload = payload.data();
+
+        const std::vector<uint8_t> encoded = encodeReference(i, payload);
+
+        expected.insert(expected.end(), encoded.begin(), encoded.end());
+    }
+
+    // All frames fit.
+    std::vector<uint8_t> buffer(expected.size());
+    size_t encoded;
+
+    TEST_ASSERT_EQUAL_UINT32(expected.size(), TinyLinkEncoder::encode(frames, 3, buffer.data(), buffer.size(), &encoded));
+    TEST_ASSERT_EQUAL_UINT32(3, encoded);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected.data(), buffer.data(), expected.size());
+
+    // The last frame does not fit.
+    const size_t length = TinyLinkEncoder::encodedLength(&frames[0]) + TinyLinkEncoder::encodedLength(&frames[1]);
+
+    TEST_ASSERT_EQUAL_UINT32(length, TinyLinkEncoder::encode(frames, 3, buffer.data(), buffer.size() - 1, &encoded));
+    TEST_ASSERT_EQUAL_UINT32(2, encoded);
+}
+
+void test_write_frame_segments(void) {
+    uint8_t buffer[512];
+    MockStream stream;
+    TinyLink tinylink(stream, buffer, sizeof(buffer));
+
+    const std::vector<uint8_t> payload = randomPayload(300, 12, 3);
+    const std::vector<uint8_t> expected = encodeReference(0x0102, payload);
+
+    // Split the payload in unequal parts, including an empty one.
+    const segment_t segments[] = {
+        {5, &payload[0]},
+        {0, &payload[5]},
+        {200, &payload[5]},
+        {95, &payload[205]}
+    };
+
+    TEST_ASSERT_TRUE(tinylink.writeFrame(0x0102, segments, 4));
+    TEST_ASSERT_EQUAL_UINT32(expected.size(), stream.written.size());
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected.data(), stream.written.data(), expected.size());
+
+    // The total length is checked.
+    const segment_t large[] = {
+        {300, &payload[0]},
+        {300, &payload[0]}
+    };
+
+    TEST_ASSERT_FALSE(tinylink.writeFrame(0x0102, large, 2));
+}
+
+void test_write_frame_streaming(void) {
+    uint8_t buffer[16];
+    MockStream stream;
+    TinyLink tinylink(stream, buffer, sizeof(buffer));
+
+    const std::vector<uint8_t> payload = randomPayload(1000, 13, 3);
+    const std::vector<uint8_t> expected = encodeReference(0x0003, payload);
+
+    // The payload is larger than the buffer.
+    tinylink.setMaxWriteLength(1000);
+
+    TEST_ASSERT_FALSE(tinylink.appendFrame(payload.data(), 1));
+    TEST_ASSERT_FALSE(tinylink.endFrame());
+
+    TEST_ASSERT_TRUE(tinylink.beginFrame(0x0003, 1000));
+    TEST_ASSERT_FALSE(tinylink.beginFrame(0x0003, 1000));
+
+    for (size_t offset = 0; offset < payload.size(); offset += 100) {
+        TEST_ASSERT_TRUE(tinylink.appendFrame(&payload[offset], 100));
+    }
+
+    TEST_ASSERT_FALSE(tinylink.appendFrame(payload.data(), 1));
+    TEST_ASSERT_TRUE(tinylink.endFrame());
+
+    TEST_ASSERT_EQUAL_UINT32(expected.size(), stream.written.size());
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected.data(), stream.written.data(), expected.size());
+}
+
+void test_write_frame_streaming_incomplete(void) {
+    uint8_t buffer[64];
+    MockStream stream;
+    TinyLink tinylink(stream, buffer, sizeof(buffer));
+
+    const std::vector<uint8_t> payload = randomPayload(10, 14, 0);
+
+    TEST_ASSERT_FALSE(tinylink.beginFrame(0x0001, 100));
+
+    TEST_ASSERT_TRUE(tinylink.beginFrame(0x0001, 20));
+    TEST_ASSERT_TRUE(tinylink.appendFrame(payload.data(), 10));
+    TEST_ASSERT_FALSE(tinylink.endFrame());
+
+    // A new frame can be written after an aborted one.
+    stream.written.clear();
+
+    TEST_ASSERT_TRUE(tinylink.write(0x0001, payload.data(), 10));
+    TEST_ASSERT_TRUE(encodeReference(0x0001, payload) == stream.written);
+}
+
+/**
+ * @brief Payload and events collected from the chunk callback.
+ */
+struct ReceivedChunks {
+    std::vector<uint8_t> payload;
+    std::vector<uint16_t> sizes;
+    std::vector<tinylink_chunk_e> events;
+};
+
+static void collectChunk(tinylink_chunk_e event, const chunk_t* chunk, void* context) {
+    ReceivedChunks* received = static_cast<ReceivedChunks*>(context);
+
+    received->events.push_back(event);
+
+    if (event == CHUNK_DATA) {
+        TEST_ASSERT_EQUAL_UINT16(received->payload.size(), chunk->offset);
+
+        received->payload.insert(received->payload.end(), chunk->data, chunk->data + chunk->size);
+        received->sizes.push_back(chunk->size);
+    }
+    else {
+        TEST_ASSERT_EQUAL_UINT16(0, chunk->offset);
+        TEST_ASSERT_EQUAL_UINT16(0, chunk->size);
+    }
+}
+
+void test_decoder_chunks(void) {
+    // Chunks of 16 bytes, for a frame that is much larger than the buffer.
+    uint8_t buffer[LEN_HEADER + 16];
+    TinyLinkDecoder decoder(buffer, sizeof(buffer));
+    ReceivedChunks received;
+
+    decoder.setChunkCallback(collectChunk, &received);
+
+    const std::vector<uint8_t> payload = randomPayload(4000, 15, 3);
+    const std::vector<uint8_t> encoded = encodeReference(0x0001, payload);
+
+    frame_t frame;
+    size_t consumed;
+
+    TEST_ASSERT_FALSE(decoder.feed(encoded.data(), encoded.size(), &consumed, &frame));
+    TEST_ASSERT_TRUE(payload == received.payload);
+    TEST_ASSERT_EQUAL_UINT32(250 + 1, received.events.size());
+    TEST_ASSERT_EQUAL(CHUNK_VALID, received.events.back());
+
+    for (uint16_t size : received.sizes) {
+        TEST_ASSERT_EQUAL_UINT16(16, size);
+    }
+
+    // The last chunk may be smaller, and a corrupted frame is signalled.
+    const std::vector<uint8_t> small = randomPayload(20, 16, 3);
+    std::vector<uint8_t> corrupted = encodeReference(0x0001, small);
+
+    corrupted[corrupted.size() - 1] ^= 0x01;
+    received = ReceivedChunks();
+
+    TEST_ASSERT_FALSE(decoder.feed(corrupted.data(), corrupted.size(), &consumed, &frame));
+    TEST_ASSERT_TRUE(small == received.payload);
+    TEST_ASSERT_EQUAL_UINT32(2, received.sizes.size());
+    TEST_ASSERT_EQUAL_UINT16(4, received.sizes[1]);
+    TEST_ASSERT_EQUAL(CHUNK_INVALID, received.events.back());
+
+    // A frame interrupted by a reset is signalled as well.
+    received = ReceivedChunks();
+
+    TEST_ASSERT_FALSE(decoder.feed(encoded.data(), 100, &consumed, &frame));
+    decoder.reset();
+
+    TEST_ASSERT_EQUAL(CHUNK_INVALID, received.events.back());
+
+    // With a maximum length, the large frame is rejected before any chunk.
+    received = ReceivedChunks();
+    decoder.setMaxLength(3999);
+
+    TEST_ASSERT_FALSE(decoder.feed(encoded.data(), encoded.size(), &consumed, &frame));
+    TEST_ASSERT_EQUAL_UINT32(0, received.events.size());
+}
+
+void test_decoder_chunks_small_buffer(void) {
+    // A buffer without room for a payload byte cannot hold chunks.
+    uint8_t header[LEN_HEADER];
+    TinyLinkDecoder tooShort(header, sizeof(header) - 1);
+    TinyLinkDecoder headerOnly(header, sizeof(header));
+    ReceivedChunks received;
+
+    TEST_ASSERT_FALSE(tooShort.setChunkCallback(collectChunk, &received));
+    TEST_ASSERT_FALSE(headerOnly.setChunkCallback(collectChunk, &received));
+    TEST_ASSERT_TRUE(headerOnly.setChunkCallback(NULL, NULL));
+
+    const std::vector<uint8_t> payload = randomPayload(64, 17, 3);
+    const std::vector<uint8_t> encoded = encodeReference(0x0001, payload);
+
+    frame_t frame;
+    size_t consumed;
+
+    TEST_ASSERT_FALSE(headerOnly.feed(encoded.data(), encoded.size(), &consumed, &frame));
+    TEST_ASSERT_EQUAL_UINT32(0, received.events.size());
+
+    // One byte past the header is enough for chunks of a single byte.
+    uint8_t buffer[LEN_HEADER + 1];
+    TinyLinkDecoder decoder(buffer, sizeof(buffer));
+
+    TEST_ASSERT_TRUE(decoder.setChunkCallback(collectChunk, &received));
+    TEST_ASSERT_FALSE(decoder.feed(encoded.data(), encoded.size(), &consumed, &frame));
+    TEST_ASSERT_TRUE(payload == received.payload);
+    TEST_ASSERT_EQUAL_UINT32(64 + 1, received.events.size());
+    TEST_ASSERT_EQUAL(CHUNK_VALID, received.events.back());
+
+    for (uint16_t size : received.sizes) {
+        TEST_ASSERT_EQUAL_UINT16(1, size);
+    }
+}
+
+void test_decoder_destination(void) {
+    // The buffer only holds the header.
+    uint8_t buffer[LEN_HEADER];
+    uint8_t destination[100];
+    TinyLinkDecoder decoder(buffer, sizeof(buffer));
+
+    decoder.setDestination(destination, sizeof(destination));
+
+    const std::vector<uint8_t> payload = randomPayload(100, 17, 3);
+    const std::vector<uint8_t> encoded = encodeReference(0x0001, payload);
+
+    frame_t frame;
+    size_t consumed;
+
+    TEST_ASSERT_TRUE(decoder.feed(encoded.data(), encoded.size(), &consumed, &frame));
+    TEST_ASSERT_EQUAL_PTR(destination, frame.payload);
+    TEST_ASSERT_EQUAL_UINT16(100, frame.length);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(payload.data(), destination, payload.size());
+
+    // A frame that is too large leaves the destination untouched.
+    const std::vector<uint8_t> large = encodeReference(0x0001, randomPayload(101, 18, 3));
+
+    memset(destination, 0x5A, sizeof(destination));
+
+    TEST_ASSERT_FALSE(decoder.feed(large.data(), large.size(), &consumed, &frame));
+
+    for (uint8_t value : destination) {
+        TEST_ASSERT_EQUAL_UINT8(0x5A, value);
+    }
+
+    // A corrupted frame clears the destination.
+    std::vector<uint8_t> corrupted = encodeReference(0x0001, randomPayload(50, 19, 3));
+
+    corrupted[corrupted.size() - 1] ^= 0x01;
+
+    TEST_ASSERT_FALSE(decoder.feed(corrupted.data(), corrupted.size(), &consumed, &frame));
+
+    for (size_t i = 0; i < sizeof(destination); i++) {
+        TEST_ASSERT_EQUAL_UINT8(i < 50 ? 0x00 : 0x5A, destination[i]);
+    }
+}
+
+static uint8_t* selectDestination(uint16_t flags, uint16_t length, void* context) {
+    uint8_t* destination = static_cast<uint8_t*>(context);
+
+    return (flags == 0x0001 && length <= 100) ? destination : NULL;
+}
+
+void test_decoder_destination_callback(void) {
+    uint8_t buffer[64];
+    uint8_t destination[100];
+    TinyLinkDecoder decoder(buffer, sizeof(buffer));
+
+    decoder.setDestinationCallback(selectDestination, destination);
+
+    const std::vector<uint8_t> payload = randomPayload(20, 20, 3);
+    const std::vector<uint8_t> first = encodeReference(0x0001, payload);
+    const std::vector<uint8_t> second = encodeReference(0x0002, payload);
+
+    frame_t frame;
+    size_t consumed;
+
+    TEST_ASSERT_TRUE(decoder.feed(first.data(), first.size(), &consumed, &frame));
+    TEST_ASSERT_EQUAL_PTR(destination, frame.payload);
+
+    TEST_ASSERT_TRUE(decoder.feed(second.data(), second.size(), &consumed, &frame));
+    TEST_ASSERT_EQUAL_PTR(&buffer[LEN_HEADER], frame.payload);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(payload.data(), frame.payload, payload.size());
+}
+
+void test_pool_keeps_frames_until_released(void) {
+    uint8_t buffer[3 * 64];
+    MockStream stream;
+    TinyLinkPool<3> pool(stream, buffer, sizeof(buffer));
+
+    std::vector<std::vector<uint8_t>> payloads;
+
+    for (uint16_t i = 0; i < 5; i++) {
+        payloads.push_back(randomPayload(10 + i * 10, i, 3));
+        stream.feed(encodeReference(i, payloads.back()));
+    }
+
+    // Three frames fill all slots, and all remain valid.
+    frame_t frames[3];
+    uint8_t slots[3];
+
+    for (uint8_t i = 0; i < 3; i++) {
+        TEST_ASSERT_TRUE(pool.readFrame(&frames[i], &slots[i]));
+        TEST_ASSERT_EQUAL_UINT16(i, frames[i].flags);
+    }
+
+    TEST_ASSERT_EQUAL_UINT8(0, pool.available());
+
+    for (uint8_t i = 0; i < 3; i++) {
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(payloads[i].data(), frames[i].payload, payloads[i].size());
+    }
+
+    // No data is consumed while all slots are in use.
+    const int remaining = stream.available();
+    frame_t frame;
+    uint8_t slot;
+
+    TEST_ASSERT_FALSE(pool.readFrame(&frame, &slot));
+    TEST_ASSERT_EQUAL_INT(remaining, stream.available());
+
+    // Releasing a slot makes room for the next frame.
+    pool.release(slots[1]);
+
+    TEST_ASSERT_TRUE(pool.readFrame(&frame, &slot));
+    TEST_ASSERT_EQUAL_UINT16(3, frame.flags);
+    TEST_ASSERT_EQUAL_UINT8(slots[1], slot);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(payloads[0].data(), frames[0].payload, payloads[0].size());
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(payloads[2].data(), frames[2].payload, payloads[2].size());
+
+    // Frames that do not fit in a slot are dropped.
+    pool.release(slot);
+    stream.feed(encodeReference(0x0010, randomPayload(65, 21, 3)));
+
+    TEST_ASSERT_TRUE(pool.readFrame(&frame, &slot));
+    TEST_ASSERT_EQUAL_UINT16(4, frame.flags);
+    pool.release(slot);
+
+    TEST_ASSERT_FALSE(pool.readFrame(&frame, &slot));
+    TEST_ASSERT_EQUAL_INT(0, stream.available());
+}
+
+void test_ring_push_and_read(void) {
+    TinyLinkRing<8> ring;
+    uint8_t data[8];
+
+    for (uint8_t i = 0; i < 8; i++) {
+        TEST_ASSERT_TRUE(ring.push(i));
+    }
+
+    TEST_ASSERT_FALSE(ring.push(8));
+    TEST_ASSERT_EQUAL_UINT32(1, ring.getOverflows());
+    TEST_ASSERT_EQUAL_UINT32(8, ring.available());
+
+    TEST_ASSERT_EQUAL_UINT32(5, ring.read(data, 5));
+    TEST_ASSERT_EQUAL_UINT8(4, data[4]);
+
+    // Write across the end of the ring, dropping what does not fit.
+    const uint8_t more[] = {10, 11, 12, 13, 14, 15, 16};
+
+    TEST_ASSERT_EQUAL_UINT32(5, ring.write(more, sizeof(more)));
+    TEST_ASSERT_EQUAL_UINT32(3, ring.getOverflows());
+
+    // The readable data is split in two spans.
+    size_t length;
+    const uint8_t* span = ring.peek(&length);
+
+    TEST_ASSERT_EQUAL_UINT32(3, length);
+    TEST_ASSERT_EQUAL_UINT8(5, span[0]);
+    ring.consume(length);
+
+    span = ring.peek(&length);
+
+    TEST_ASSERT_EQUAL_UINT32(5, length);
+    TEST_ASSERT_EQUAL_UINT8(10, span[0]);
+    TEST_ASSERT_EQUAL_UINT8(14, span[4]);
+    ring.consume(length);
+
+    TEST_ASSERT_EQUAL_UINT32(0, ring.available());
+    TEST_ASSERT_EQUAL_UINT32(0, ring.read(data, sizeof(data)));
+}
+
+void test_ring_concurrent(void) {
+    static TinyLinkRing<64> ring;
+    const size_t count = 100000;
+
+    // The producer thread plays the role of an interrupt handler.
+    std::thread producer([&]() {
+        for (size_t i = 0; i < count; i++) {
+            while (!ring.push(static_cast<uint8_t>(i * 7))) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    size_t received = 0;
+    bool ordered = true;
+
+    while (received < count) {
+        uint8_t data[16];
+        size_t length = ring.read(data, sizeof(data));
+
+        for (size_t i = 0; i < length; i++) {
+            ordered = ordered && data[i] == static_cast<uint8_t>((received + i) * 7);
+        }
+
+        if (length == 0) {
+            std::this_thread::yield();
+        }
+
+        received += length;
+    }
+
+    producer.join();
+
+    TEST_ASSERT_TRUE(ordered);
+}
+
+void test_ring_drained_into_decoder(void) {
+    TinyLinkRing<32> ring;
+    uint8_t buffer[128];
+    TinyLinkDecoder decoder(buffer, sizeof(buffer));
+
+    std::vector<uint8_t> data;
+
+    for (uint16_t i = 0; i < 4; i++) {
+        const std::vector<uint8_t> encoded = encodeReference(i, randomPayload(30, i, 3));
+
+        data.insert(data.end(), encoded.begin(), encoded.end());
+    }
+
+    // Push bytes in, and drain the ring into the decoder without copying.
+    std::vector<uint16_t> flags;
+    size_t offset = 0;
+
+    while (offset < data.size() || ring.available() > 0) {
+        while (offset < data.size() && ring.push(data[offset])) {
+            offset++;
+        }
+
+        size_t length;
+        const uint8_t* span = ring.peek(&length);
+
+        size_t consumed;
+        frame_t frame;
+
+        if (decoder.feed(span, length, &consumed, &frame)) {
+            flags.push_back(frame.flags);
+        }
+
+        ring.consume(consumed);
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(4, flags.size());
+    TEST_ASSERT_EQUAL_UINT16(3, flags[3]);
+}
+
+void test_queue_pumps_without_blocking(void) {
+    MockStream stream;
+    TinyLinkQueue<256> queue(stream);
+
+    std::vector<uint8_t> expected;
+
+    for (uint16_t i = 0; i < 3; i++) {
+        const std::vector<uint8_t> payload = randomPayload(40, i, 4);
+        const std::vector<uint8_t> encoded = encodeReference(i, payload);
+
+        TEST_ASSERT_TRUE(queue.enqueue(i, payload.data(), static_cast<uint16_t>(payload.size())));
+
+        expected.insert(expected.end(), encoded.begin(), encoded.end());
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(3, queue.getDepth());
+    TEST_ASSERT_TRUE(stream.written.empty());
+
+    // Nothing is written while the stream cannot take bytes.
+    stream.space = 0;
+
+    TEST_ASSERT_EQUAL_UINT32(0, queue.pump());
+
+    // Never write more than the stream can take.
+    stream.space = 7;
+
+    while (queue.getPending() > 0) {
+        size_t before = stream.written.size();
+        size_t written = queue.pump();
+
+        TEST_ASSERT_TRUE(written <= 7);
+        TEST_ASSERT_EQUAL_UINT32(before + written, stream.written.size());
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(0, queue.getDepth());
+    TEST_ASSERT_FALSE(queue.isWriting());
+    TEST_ASSERT_EQUAL_UINT32(expected.size(), stream.written.size());
+    TEST_ASSERT_EQUAL_MEMORY(expected.data(), stream.written.data(), expected.size());
+}
+
+void test_queue_counts_drops(void) {
+    MockStream stream;
+    TinyLinkQueue<64> queue(stream);
+
+    uint8_t payload[32] = {0};
+
+    // Encoded length is 4 + 5 + 32 + 4, plus the prefix of 4 bytes.
+    TEST_ASSERT_TRUE(queue.enqueue(0x01, payload, sizeof(payload)));
+    TEST_ASSERT_FALSE(queue.enqueue(0x02, payload, sizeof(payload)));
+    TEST_ASSERT_EQUAL_UINT32(1, queue.getDrops());
+    TEST_ASSERT_EQUAL_UINT32(1, queue.getDepth());
+
+    // A frame stops at its boundary, which frees up the queue.
+    stream.space = 1000;
+
+    TEST_ASSERT_EQUAL_UINT32(45, queue.pump(1000, true));
+    TEST_ASSERT_TRUE(queue.enqueue(0x03, payload, sizeof(payload)));
+    TEST_ASSERT_EQUAL_UINT32(1, queue.getDrops());
+}
+
+void test_queue_fills_up_exactly(void) {
+    MockStream stream;
+    TinyLinkQueue<64> queue(stream);
+
+    std::vector<uint8_t> expected;
+    std::vector<size_t> sizes;
+
+    // The worst case of 4 + 2 * (5 + 10 + 4) bytes only fits the first frame,
+    // but the exact length of about 4 + 5 + 10 + 4 bytes fits both.
+    for (uint16_t i = 0; i < 2; i++) {
+        const std::vector<uint8_t> payload = randomPayload(10, i, 0);
+        const std::vector<uint8_t> encoded = encodeReference(i, payload);
+
+        TEST_ASSERT_TRUE(queue.enqueue(i, payload.data(), static_cast<uint16_t>(payload.size())));
+
+        expected.insert(expected.end(), encoded.begin(), encoded.end());
+        sizes.push_back(encoded.size());
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(0, queue.getDrops());
+    TEST_ASSERT_EQUAL_UINT32(expected.size() + 2 * LEN_QUEUE_PREFIX, queue.getPending());
+
+    // Frames that wrap around the end of the ring are intact as well.
+    stream.space = 1000;
+
+    for (uint16_t i = 2; i < 8; i++) {
+        TEST_ASSERT_EQUAL_UINT32(sizes[i - 2], queue.pump(1000, true));
+
+        const std::vector<uint8_t> payload = randomPayload(10, i, 0);
+        const std::vector<uint8_t> encoded = encodeReference(i, payload);
+
+        TEST_ASSERT_TRUE(queue.enqueue(i, payload.data(), static_cast<uint16_t>(payload.size())));
+
+        expected.insert(expected.end(), encoded.begin(), encoded.end());
+        sizes.push_back(encoded.size());
+    }
+
+    while (queue.pump() > 0) {
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(0, queue.getDrops());
+    TEST_ASSERT_EQUAL_UINT32(expected.size(), stream.written.size());
+    TEST_ASSERT_EQUAL_MEMORY(expected.data(), stream.written.data(), expected.size());
+}
+
+static uint8_t priorityFromFlags(uint16_t flags, void* context) {
+    (void) context;
+
+    return (flags & 0x8000) ? 0 : 1;
+}
+
+void test_scheduler_interleaves_at_frame_boundaries(void) {
+    MockStream stream;
+    TinyLinkScheduler<512, 2> scheduler(stream);
+
+    scheduler.setPriorityCallback(priorityFromFlags, NULL);
+
+    const std::vector<uint8_t> bulk = randomPayload(100, 1, 4);
+    const std::vector<uint8_t> control{0x01, 0x02};
+
+    frame_t frame;
+
+    for (uint16_t i = 0; i < 3; i++) {
+        frame.flags = i;
+        frame.length = static_cast<uint16_t>(bulk.size());
+        frame.payload = bulk.data();
+
+        TEST_ASSERT_TRUE(scheduler.enqueue(&frame));
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(3, scheduler.getDepth(1));
+
+    // Start writing the first bulk frame.
+    stream.space = 16;
+    scheduler.pump();
+
+    // The control frame waits for the frame that is being written only.
+    frame.flags = 0x8000;
+    frame.length = static_cast<uint16_t>(control.size());
+    frame.payload = control.data();
+
+    TEST_ASSERT_TRUE(scheduler.enqueue(&frame));
+    TEST_ASSERT_EQUAL_UINT32(1, scheduler.getDepth(0));
+
+    while (scheduler.pump() > 0) {
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(0, scheduler.getDepth(0));
+    TEST_ASSERT_EQUAL_UINT32(0, scheduler.getDepth(1));
+
+    uint8_t buffer[256];
+    TinyLinkDecoder decoder(buffer, sizeof(buffer));
+    std::vector<DecodedFrame> frames;
+
+    TEST_ASSERT_EQUAL_UINT32(4, decoder.feed(stream.written.data(), stream.written.size(), collectFrame, &frames));
+    TEST_ASSERT_EQUAL_UINT16(0x0000, frames[0].flags);
+    TEST_ASSERT_EQUAL_UINT16(0x8000, frames[1].flags);
+    TEST_ASSERT_EQUAL_UINT16(0x0001, frames[2].flags);
+    TEST_ASSERT_EQUAL_UINT16(0x0002, frames[3].flags);
+}
+
+static uint32_t fakeTime = 0;
+
+static uint32_t fakeClock(void) {
+    return fakeTime;
+}
+
+void test_aggregator_packs_messages(void) {
+    uint8_t buffer[128];
+    MockStream stream;
+    TinyLink tinylink(stream, buffer, sizeof(buffer));
+
+    uint8_t packed[32];
+    TinyLinkAggregator aggregator(tinylink, packed, sizeof(packed));
+
+    aggregator.setFlags(0x0001);
+
+    // Ten messages of 1 + 8 bytes fill three frames of 32 bytes, plus one.
+    for (uint8_t i = 0; i < 10; i++) {
+        const std::vector<uint8_t> message = randomPayload(8, i, 4);
+
+        TEST_ASSERT_TRUE(aggregator.write(message.data(), static_cast<uint8_t>(message.size())));
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(9, aggregator.getPending());
+    TEST_ASSERT_TRUE(aggregator.flush());
+    TEST_ASSERT_EQUAL_UINT32(0, aggregator.getPending());
+
+    // Messages larger than the buffer never fit.
+    uint8_t large[40] = {0};
+
+    TEST_ASSERT_FALSE(aggregator.write(large, sizeof(large)));
+
+    uint8_t receive[128];
+    TinyLinkDecoder decoder(receive, sizeof(receive));
+    std::vector<DecodedFrame> frames;
+
+    TEST_ASSERT_EQUAL_UINT32(4, decoder.feed(stream.written.data(), stream.written.size(), collectFrame, &frames));
+
+    uint8_t count = 0;
+
+    for (const DecodedFrame& decoded : frames) {
+        TEST_ASSERT_EQUAL_UINT16(FLAGS_AGGREGATE | 0x0001, decoded.flags);
+
+        frame_t frame;
+        frame.flags = decoded.flags;
+        frame.length = static_cast<uint16_t>(decoded.payload.size());
+        frame.payload = decoded.payload.data();
+
+        TinyLinkUnpacker unpacker(&frame);
+        const uint8_t* message;
+        uint8_t length;
+
+        while (unpacker.next(&message, &length)) {
+            const std::vector<uint8_t> expected = randomPayload(8, count++, 4);
+
+            TEST_ASSERT_EQUAL_UINT8(expected.size(), length);
+            TEST_ASSERT_EQUAL_MEMORY(expected.data(), message, length);
+        }
+    }
+
+    TEST_ASSERT_EQUAL_UINT8(10, count);
+}
+
+void test_aggregator_flushes_after_timeout(void) {
+    uint8_t buffer[128];
+    MockStream stream;
+    TinyLink tinylink(stream, buffer, sizeof(buffer));
+
+    uint8_t packed[64];
+    TinyLinkAggregator aggregator(tinylink, packed, sizeof(packed));
+
+    fakeTime = 1000;
+    aggregator.setTimeout(fakeClock, 10);
+
+    TEST_ASSERT_FALSE(aggregator.poll());
+
+    const uint8_t message[4] = {0xAA, 0x1B, 0x00, 0x01};
+
+    TEST_ASSERT_TRUE(aggregator.write(message, sizeof(message)));
+
+    fakeTime = 1009;
+    TEST_ASSERT_FALSE(aggregator.poll());
+    TEST_ASSERT_TRUE(stream.written.empty());
+
+    fakeTime = 1010;
+    TEST_ASSERT_TRUE(aggregator.poll());
+
+    const std::vector<uint8_t> expected = encodeReference(FLAGS_AGGREGATE, {0x04, 0xAA, 0x1B, 0x00, 0x01});
+
+    TEST_ASSERT_EQUAL_UINT32(expected.size(), stream.written.size());
+    TEST_ASSERT_EQUAL_MEMORY(expected.data(), stream.written.data(), expected.size());
+}
+
+void test_aggregator_keeps_messages_when_writing_fails(void) {
+    uint8_t buffer[128];
+    MockStream stream;
+    TinyLink tinylink(stream, buffer, sizeof(buffer));
+
+    uint8_t packed[16];
+    TinyLinkAggregator aggregator(tinylink, packed, sizeof(packed));
+
+    // The link refuses frames this large, so writing fails.
+    tinylink.setMaxWriteLength(4);
+
+    const uint8_t message[6] = {1, 2, 3, 4, 5, 6};
+
+    TEST_ASSERT_TRUE(aggregator.write(message, sizeof(message)));
+    TEST_ASSERT_TRUE(aggregator.write(message, sizeof(message)));
+    TEST_ASSERT_FALSE(aggregator.flush());
+    TEST_ASSERT_FALSE(aggregator.write(message, sizeof(message)));
+    TEST_ASSERT_EQUAL_UINT32(14, aggregator.getPending());
+    TEST_ASSERT_TRUE(stream.written.empty());
+
+    // The messages are written once the link accepts them.
+    tinylink.setMaxWriteLength(128);
+
+    TEST_ASSERT_TRUE(aggregator.write(message, sizeof(message)));
+    TEST_ASSERT_EQUAL_UINT32(7, aggregator.getPending());
+
+    const std::vector<uint8_t> expected = encodeReference(FLAGS_AGGREGATE, {6, 1, 2, 3, 4, 5, 6, 6, 1, 2, 3, 4, 5, 6});
+
+    TEST_ASSERT_EQUAL_UINT32(expected.size(), stream.written.size());
+    TEST_ASSERT_EQUAL_MEMORY(expected.data(), stream.written.data(), expected.size());
+}
+
+void test_aggregator_cobs_policy(void) {
+    uint8_t buffer[128];
+    MockStream stream;
+    BasicTinyLink<TinyLinkCobsPolicy> tinylink(stream, buffer, sizeof(buffer));
+
+    uint8_t packed[32];
+    BasicTinyLinkAggregator<TinyLinkCobsPolicy> aggregator(tinylink, packed, sizeof(packed));
+
+    // Messages full of flags, which the policy must remove from the frame.
+    const uint8_t message[6] = {FLAG, FLAG, ESCAPE, 0x00, FLAG, 0x01};
+
+    TEST_ASSERT_TRUE(aggregator.write(message, sizeof(message)));
+    TEST_ASSERT_TRUE(aggregator.write(message, sizeof(message)));
+    TEST_ASSERT_TRUE(aggregator.flush());
+    TEST_ASSERT_TRUE(stream.written.size() <= TinyLinkCobsPolicy::maxEncodedLength(14));
+
+    for (size_t i = LEN_PREAMBLE; i < stream.written.size(); i++) {
+        TEST_ASSERT_TRUE(stream.written[i] != FLAG);
+    }
+
+    uint8_t receive[128];
+    BasicTinyLinkDecoder<TinyLinkCobsPolicy> decoder(receive, sizeof(receive));
+    std::vector<DecodedFrame> frames;
+
+    TEST_ASSERT_EQUAL_UINT32(1, decoder.feed(stream.written.data(), stream.written.size(), collectFrame, &frames));
+    TEST_ASSERT_EQUAL_UINT16(FLAGS_AGGREGATE, frames[0].flags);
+
+    frame_t frame;
+    frame.flags = frames[0].flags;
+    frame.length = static_cast<uint16_t>(frames[0].payload.size());
+    frame.payload = frames[0].payload.data();
+
+    TinyLinkUnpacker unpacker(&frame);
+    const uint8_t* unpacked;
+    uint8_t length;
+
+    for (uint8_t i = 0; i < 2; i++) {
+        TEST_ASSERT_TRUE(unpacker.next(&unpacked, &length));
+        TEST_ASSERT_EQUAL_UINT8(sizeof(message), length);
+        TEST_ASSERT_EQUAL_MEMORY(message, unpacked, length);
+    }
+
+    TEST_ASSERT_FALSE(unpacker.next(&unpacked, &length));
+}
+
+void test_unpacker_stops_at_malformed_message(void) {
+    const uint8_t payload[] = {0x02, 0x10, 0x11, 0x05, 0x20};
+
+    frame_t frame;
+    frame.flags = FLAGS_AGGREGATE;
+    frame.length = sizeof(payload);
+    frame.payload = payload;
+
+    TinyLinkUnpacker unpacker(&frame);
+    const uint8_t* message;
+    uint8_t length;
+
+    TEST_ASSERT_TRUE(unpacker.next(&message, &length));
+    TEST_ASSERT_EQUAL_UINT8(2, length);
+    TEST_ASSERT_EQUAL_UINT8(0x11, message[1]);
+    TEST_ASSERT_FALSE(unpacker.next(&message, &length));
+    TEST_ASSERT_FALSE(unpacker.next(&message, &length));
+
+    // Frames that are not aggregated contain no messages.
+    frame.flags = 0x0001;
+
+    TinyLinkUnpacker plain(&frame);
+
+    TEST_ASSERT_FALSE(plain.next(&message, &length));
+}
+
+void test_cobs_policy_round_trip(void) {
+    uint8_t buffer[1024];
+    MockStream stream;
+    BasicTinyLink<TinyLinkCobsPolicy> tinylink(stream, buffer, sizeof(buffer));
+
+    uint8_t receive[1024];
+    BasicTinyLinkDecoder<TinyLinkCobsPolicy> decoder(receive, sizeof(receive));
+
+    // Lengths around the maximum run, with and without bytes to escape.
+    const uint16_t lengths[] = {0, 1, 240, 241, 242, 245, 253, 254, 255, 600};
+    const uint8_t densities[] = {0, 1, 2, 255};
+
+    for (uint16_t length : lengths) {
+        for (uint8_t density : densities) {
+            std::vector<uint8_t> payload = randomPayload(length, length + density, density);
+
+            if (density == 255) {
+                payload.assign(length, FLAG);
+            }
+
+            stream.written.clear();
+
+            TEST_ASSERT_TRUE(tinylink.write(0x1234, payload.data(), length));
+
+            // Only the preamble contains the flag, and the overhead is bounded.
+            const std::vector<uint8_t>& written = stream.written;
+
+            TEST_ASSERT_TRUE(written.size() <= TinyLinkCobsPolicy::maxEncodedLength(length));
+
+            for (size_t i = LEN_PREAMBLE; i < written.size(); i++) {
+                TEST_ASSERT_TRUE(written[i] != FLAG);
+            }
+
+            std::vector<DecodedFrame> frames;
+
+            TEST_ASSERT_EQUAL_UINT32(1, decoder.feed(written.data(), written.size(), collectFrame, &frames));
+            TEST_ASSERT_EQUAL_UINT16(0x1234, frames[0].flags);
+            TEST_ASSERT_EQUAL_UINT32(length, frames[0].payload.size());
+
+            if (length > 0) {
+                TEST_ASSERT_EQUAL_MEMORY(payload.data(), frames[0].payload.data(), length);
+            }
+        }
+    }
+}
+
+void test_cobs_policy_resynchronizes(void) {
+    uint8_t buffer[256];
+    MockStream stream;
+    BasicTinyLink<TinyLinkCobsPolicy> tinylink(stream, buffer, sizeof(buffer));
+
+    // Abort a frame halfway, followed by a complete frame.
+    const std::vector<uint8_t> payload = randomPayload(100, 7, 4);
+
+    TEST_ASSERT_TRUE(tinylink.beginFrame(0x0001, 200));
+    TEST_ASSERT_TRUE(tinylink.appendFrame(payload.data(), 100));
+    TEST_ASSERT_FALSE(tinylink.endFrame());
+    TEST_ASSERT_TRUE(tinylink.write(0x0002, payload.data(), 100));
+
+    // The preamble of the second frame ends the first frame.
+    stream.feed(stream.written);
+
+    frame_t frame;
+    size_t frames = 0;
+
+    while (stream.available() > 0) {
+        if (tinylink.readFrame(&frame)) {
+            TEST_ASSERT_EQUAL_UINT16(0x0002, frame.flags);
+            TEST_ASSERT_EQUAL_MEMORY(payload.data(), frame.payload, 100);
+            frames++;
+        }
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(1, frames);
+
+    // The same holds when scanning the bytes of the aborted frame again.
+    uint8_t receive[256];
+    uint8_t resync[256];
+    BasicTinyLinkDecoder<TinyLinkCobsPolicy> decoder(receive, sizeof(receive));
+    std::vector<DecodedFrame> decoded;
+
+    decoder.setResyncBuffer(resync, sizeof(resync));
+
+    TEST_ASSERT_EQUAL_UINT32(1, decoder.feed(stream.written.data(), stream.written.size(), collectFrame, &decoded));
+    TEST_ASSERT_EQUAL_UINT16(0x0002, decoded[0].flags);
+}
+
+void test_decoder_hunts_preamble_in_noise(void) {
+    // Noise full of partial preambles, followed by a frame, repeated.
+    const std::vector<uint8_t> noise{0xAA, 0x55, 0xAA, 0x55, 0x55, 0xAA, 0x55, 0x00, 0xAA, 0xAA, 0x55, 0xAA};
+
+    std::vector<uint8_t> data;
+
+    for (uint16_t i = 0; i < 8; i++) {
+        const std::vector<uint8_t> random = randomPayload(i * 37, i, 2);
+        const std::vector<uint8_t> encoded = encodeReference(i, randomPayload(20, i, 3));
+
+        data.insert(data.end(), noise.begin(), noise.end());
+        data.insert(data.end(), random.begin(), random.end());
+
+        // Noise that ends with a partial preamble would synchronize early.
+        data.push_back(0x00);
+        data.insert(data.end(), encoded.begin(), encoded.end());
+    }
+
+    // Feed in slices of varying size, so the preamble is split across calls.
+    for (size_t slice = 1; slice <= 7; slice++) {
+        uint8_t buffer[64];
+        TinyLinkDecoder decoder(buffer, sizeof(buffer));
+        std::vector<DecodedFrame> frames;
+
+        for (size_t offset = 0; offset < data.size(); offset += slice) {
+            size_t length = std::min(slice, data.size() - offset);
+
+            decoder.feed(&data[offset], length, collectFrame, &frames);
+        }
+
+        TEST_ASSERT_EQUAL_UINT32(8, frames.size());
+
+        for (uint16_t i = 0; i < 8; i++) {
+            TEST_ASSERT_EQUAL_UINT16(i, frames[i].flags);
+        }
+    }
+
+    // Pushing byte by byte finds the same frames.
+    uint8_t buffer[64];
+    TinyLinkDecoder decoder(buffer, sizeof(buffer));
+    size_t count = 0;
+    frame_t frame;
+
+    for (uint8_t byte : data) {
+        if (decoder.push(byte, &frame)) {
+            TEST_ASSERT_EQUAL_UINT16(count++, frame.flags);
+        }
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(8, count);
+}
+
+void test_decoder_resync_recovers_hidden_frames(void) {
+    // A truncated frame, with the next frames starting inside it.
+    const std::vector<uint8_t> first = encodeReference(0x0001, randomPayload(60, 1, 4));
+    const std::vector<uint8_t> second = encodeReference(0x0002, randomPayload(20, 2, 4));
+    const std::vector<uint8_t> third = encodeReference(0x0003, randomPayload(10, 3, 4));
+
+    std::vector<uint8_t> data(first.begin(), first.begin() + 30);
+
+    data.insert(data.end(), second.begin(), second.end());
+    data.insert(data.end(), third.begin(), third.end());
+    data.insert(data.end(), first.begin(), first.end());
+
+    // Without enough room, the frames inside the first one are lost. The
+    // first one is retransmitted, and always received.
+    const size_t sizes[] = {0, 16, 256};
+    const size_t expected[] = {1, 1, 3};
+
+    for (size_t i = 0; i < 3; i++) {
+        uint8_t buffer[128];
+        uint8_t resync[256];
+        TinyLinkDecoder decoder(buffer, sizeof(buffer));
+
+        if (sizes[i] > 0) {
+            decoder.setResyncBuffer(resync, sizes[i]);
+        }
+
+        std::vector<DecodedFrame> frames;
+
+        decoder.feed(data.data(), data.size(), collectFrame, &frames);
+
+        TEST_ASSERT_EQUAL_UINT32(expected[i], frames.size());
+        TEST_ASSERT_EQUAL_UINT16(0x0001, frames.back().flags);
+    }
+
+    // The same frames are recovered when pushing byte by byte.
+    uint8_t buffer[128];
+    uint8_t resync[256];
+    TinyLinkDecoder decoder(buffer, sizeof(buffer));
+
+    decoder.setResyncBuffer(resync, sizeof(resync));
+
+    std::vector<uint16_t> flags;
+    std::vector<size_t> offsets;
+    frame_t frame;
+
+    for (uint8_t byte : data) {
+        if (decoder.push(byte, &frame)) {
+            flags.push_back(frame.flags);
+            offsets.push_back(decoder.getFrameOffset());
+        }
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(3, flags.size());
+    TEST_ASSERT_EQUAL_UINT16(0x0002, flags[0]);
+    TEST_ASSERT_EQUAL_UINT16(0x0003, flags[1]);
+    TEST_ASSERT_EQUAL_UINT16(0x0001, flags[2]);
+
+    // Frames found by scanning again are at their offset in the stream.
+    TEST_ASSERT_EQUAL_UINT32(30, offsets[0]);
+    TEST_ASSERT_EQUAL_UINT32(30 + second.size(), offsets[1]);
+    TEST_ASSERT_EQUAL_UINT32(30 + second.size() + third.size(), offsets[2]);
+}
+
+/**
+ * @brief Encode a frame that ends exactly where the frames inside it end, with
+ * a CRC that does not match. The header does not need escaping.
+ */
+static std::vector<uint8_t> encodeEnclosing(const std::vector<uint8_t>& inner) {
+    size_t unescaped = 0;
+
+    for (size_t i = 0; i < inner.size(); i++, unescaped++) {
+        if (inner[i] == ESCAPE) {
+            i++;
+        }
+    }
+
+    const uint16_t length = static_cast<uint16_t>(unescaped - LEN_CRC);
+    const std::vector<uint8_t> outer = encodeReference(0x0001, std::vector<uint8_t>(length, 0x00));
+
+    std::vector<uint8_t> result(outer.begin(), outer.begin() + LEN_PREAMBLE + LEN_HEADER);
+
+    result.insert(result.end(), inner.begin(), inner.end());
+
+    return result;
+}
+
+void test_link_drains_recovered_frames(void) {
+    // No bytes follow the rejected frame.
+    const std::vector<uint8_t> second = encodeReference(0x0002, randomPayload(20, 2, 4));
+    const std::vector<uint8_t> third = encodeReference(0x0003, randomPayload(10, 3, 4));
+
+    std::vector<uint8_t> inner(second.begin(), second.end());
+
+    inner.insert(inner.end(), third.begin(), third.end());
+
+    const std::vector<uint8_t> data = encodeEnclosing(inner);
+
+    // Both frames are received by reading and by polling, without more bytes
+    // arriving.
+    for (size_t polling = 0; polling < 2; polling++) {
+        uint8_t buffer[128];
+        uint8_t resync[256];
+        MockStream stream;
+        TinyLink tinylink(stream, buffer, sizeof(buffer));
+
+        tinylink.setResyncBuffer(resync, sizeof(resync));
+        stream.feed(data);
+
+        std::vector<uint16_t> flags;
+        frame_t frame;
+
+        for (size_t i = 0; i < data.size() + 2; i++) {
+            if (polling ? tinylink.pollFrame(&frame) : tinylink.readFrame(&frame)) {
+                flags.push_back(frame.flags);
+            }
+        }
+
+        TEST_ASSERT_EQUAL_UINT32(2, flags.size());
+        TEST_ASSERT_EQUAL_UINT16(0x0002, flags[0]);
+        TEST_ASSERT_EQUAL_UINT16(0x0003, flags[1]);
+    }
+}
+
+void test_decoder_push_scans_full_resync_buffer(void) {
+    const std::vector<uint8_t> second = encodeReference(0x0002, randomPayload(20, 2, 4));
+    const std::vector<uint8_t> third = encodeReference(0x0003, randomPayload(10, 3, 4));
+    const std::vector<uint8_t> fourth = encodeReference(0x0004, randomPayload(10, 4, 4));
+
+    std::vector<uint8_t> inner(second.begin(), second.end());
+
+    inner.insert(inner.end(), third.begin(), third.end());
+
+    std::vector<uint8_t> data = encodeEnclosing(inner);
+    const size_t recorded = data.size() - LEN_PREAMBLE;
+
+    data.insert(data.end(), fourth.begin(), fourth.end());
+
+    // The resync buffer is exactly full when the enclosing frame is rejected,
+    // so the next byte pushed does not fit.
+    uint8_t buffer[128];
+    std::vector<uint8_t> resync(recorded);
+    TinyLinkDecoder decoder(buffer, sizeof(buffer));
+
+    decoder.setResyncBuffer(resync.data(), resync.size());
+
+    std::vector<uint16_t> flags;
+    frame_t frame;
+
+    for (uint8_t byte : data) {
+        if (decoder.push(byte, &frame)) {
+            flags.push_back(frame.flags);
+        }
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(3, flags.size());
+    TEST_ASSERT_EQUAL_UINT16(0x0002, flags[0]);
+    TEST_ASSERT_EQUAL_UINT16(0x0003, flags[1]);
+    TEST_ASSERT_EQUAL_UINT16(0x0004, flags[2]);
+}
+
+void test_decoder_resync_recovers_frame_after_dropped_byte(void) {
+    // A byte of the payload of the first frame is lost, so the first frame
+    // ends in the preamble of the second one.
+    const std::vector<uint8_t> first = encodeReference(0x0001, std::vector<uint8_t>(40, 0x11));
+    const std::vector<uint8_t> second = encodeReference(0x0002, randomPayload(20, 2, 4));
+
+    std::vector<uint8_t> data(first);
+
+    data.erase(data.begin() + LEN_PREAMBLE + LEN_HEADER + 10);
+    data.insert(data.end(), second.begin(), second.end());
+
+    // Without a resync buffer, the second frame is lost as well.
+    const size_t sizes[] = {0, 256};
+    const size_t expected[] = {0, 1};
+
+    for (size_t i = 0; i < 2; i++) {
+        uint8_t buffer[128];
+        uint8_t resync[256];
+        TinyLinkDecoder decoder(buffer, sizeof(buffer));
+        std::vector<DecodedFrame> frames;
+
+        if (sizes[i] > 0) {
+            decoder.setResyncBuffer(resync, sizes[i]);
+        }
+
+        decoder.feed(data.data(), data.size(), collectFrame, &frames);
+
+        TEST_ASSERT_EQUAL_UINT32(expected[i], frames.size());
+
+        if (expected[i] > 0) {
+            TEST_ASSERT_EQUAL_UINT16(0x0002, frames[0].flags);
+        }
+    }
+}
+
+void test_decoder_resync_never_loses_frames(void) {
+    uint32_t seed = 0x5EED;
+    size_t plainFrames = 0;
+    size_t resyncFrames = 0;
+
+    for (size_t iteration = 0; iteration < 200; iteration++) {
+        // Frames of random length, of which some are truncated, some are
+        // corrupted, and some are followed by noise.
+        std::vector<uint8_t> data;
+
+        for (uint16_t i = 0; i < 30; i++) {
+            seed = seed * 1103515245 + 12345;
+
+            const size_t length = (seed >> 8) % (((seed >> 24) & 0x3) == 0 ? 700 : 60);
+            std::vector<uint8_t> encoded = encodeReference(i, randomPayload(length, seed, 16));
+
+            seed = seed * 1103515245 + 12345;
+
+            if (((seed >> 24) & 0x3) == 0) {
+                encoded.resize((seed >> 8) % encoded.size());
+            }
+            else if (((seed >> 24) & 0x3) == 1) {
+                encoded[(seed >> 8) % encoded.size()] ^= 0x10;
+            }
+
+            data.insert(data.end(), encoded.begin(), encoded.end());
+
+            if (((seed >> 26) & 0x3) == 0) {
+                const std::vector<uint8_t> noise = randomPayload((seed >> 16) % 20, seed, 0);
+
+                data.insert(data.end(), noise.begin(), noise.end());
+            }
+        }
+
+        // Enough padding to reject any frame still in progress, so frames
+        // after it are decoded again.
+        data.insert(data.end(), 2048, 0x00);
+
+        uint8_t buffer[1024];
+        TinyLinkDecoder plain(buffer, sizeof(buffer));
+        std::vector<DecodedFrame> expected;
+
+        plain.feed(data.data(), data.size(), collectFrame, &expected);
+
+        // Every frame received without a resync buffer is received with a
+        // small one as well, even if frames found by scanning again do not fit.
+        const size_t sizes[] = {64, 128, 256, 512};
+
+        for (size_t size : sizes) {
+            uint8_t resync[512];
+            TinyLinkDecoder decoder(buffer, sizeof(buffer));
+            std::vector<DecodedFrame> frames;
+
+            decoder.setResyncBuffer(resync, size);
+            decoder.feed(data.data(), data.size(), collectFrame, &frames);
+
+            if (size == sizeof(resync)) {
+                plainFrames += expected.size();
+                resyncFrames += frames.size();
+            }
+
+            for (const DecodedFrame& frame : expected) {
+                bool found = false;
+
+                for (const DecodedFrame& other : frames) {
+                    found = found || (other.flags == frame.flags && other.payload == frame.payload);
+                }
+
+                TEST_ASSERT_TRUE(found);
+            }
+        }
+    }
+
+    // Frames that start inside corrupted ones are recovered as well.
+    TEST_ASSERT_TRUE(resyncFrames > plainFrames);
+}
+
+void test_decoder_timeout_aborts_stale_frames(void) {
+    const std::vector<uint8_t> stale = encodeReference(0x0001, randomPayload(100, 1, 4));
+    const std::vector<uint8_t> fresh = encodeReference(0x0002, randomPayload(20, 2, 4));
+
+    // Without timeout, the next frame is received as part of the stale one.
+    // With either timeout, the stale frame is aborted.
+    const uint32_t byteTimeouts[] = {0, 50, 0};
+    const uint32_t frameTimeouts[] = {0, 0, 80};
+    const size_t expected[] = {0, 1, 1};
+
+    for (size_t i = 0; i < 3; i++) {
+        uint8_t buffer[128];
+        TinyLinkDecoder decoder(buffer, sizeof(buffer));
+        std::vector<DecodedFrame> frames;
+
+        fakeTime = 0;
+        decoder.setTimeout(fakeClock, byteTimeouts[i], frameTimeouts[i]);
+
+        // The line drops after 40 bytes, which arrive 10 ms apart.
+        for (size_t offset = 0; offset < 40; offset += 10) {
+            decoder.feed(&stale[offset], 10, collectFrame, &frames);
+            fakeTime += 10;
+        }
+
+        fakeTime += 60;
+
+        decoder.feed(fresh.data(), fresh.size(), collectFrame, &frames);
+
+        TEST_ASSERT_EQUAL_UINT32(expected[i], frames.size());
+    }
+
+    // Expiring without bytes arriving releases the partial frame.
+    uint8_t buffer[128];
+    TinyLinkDecoder decoder(buffer, sizeof(buffer));
+    frame_t frame;
+
+    fakeTime = 0;
+    decoder.setTimeout(fakeClock, 50, 0);
+
+    for (size_t offset = 0; offset < 20; offset++) {
+        decoder.push(stale[offset], &frame);
+    }
+
+    TEST_ASSERT_EQUAL(WAITING_FOR_BODY, decoder.getState());
+    TEST_ASSERT_FALSE(decoder.expire());
+
+    fakeTime = 50;
+
+    TEST_ASSERT_TRUE(decoder.expire());
+    TEST_ASSERT_EQUAL(WAITING_FOR_PREAMBLE, decoder.getState());
+}
+
+#ifdef TINYLINK_HAS_GATEWAY
+struct GatewayFrame {
+    size_t link;
+    bool closed;
+    uint16_t flags;
+    std::vector<uint8_t> payload;
+};
+
+static void collectGatewayFrame(size_t link, const frame_t* frame, void* context) {
+    std::vector<GatewayFrame>* frames = static_cast<std::vector<GatewayFrame>*>(context);
+
+    if (frame == NULL) {
+        frames->push_back({link, true, 0, {}});
+    }
+    else {
+        frames->push_back({link, false, frame->flags, std::vector<uint8_t>(frame->payload, frame->payload + frame->length)});
+    }
+}
+
+void test_gateway_over_socketpairs(void) {
+    std::vector<GatewayFrame> frames;
+    TinyLinkGateway gateway(4, 256, collectGatewayFrame, &frames);
+
+    int sockets[3];
+    int peers[3];
+    int links[3];
+
+    for (size_t i = 0; i < 3; i++) {
+        int fds[2];
+
+        TEST_ASSERT_EQUAL(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+
+        links[i] = gateway.add(fds[0]);
+        sockets[i] = fds[0];
+        peers[i] = fds[1];
+
+        TEST_ASSERT_EQUAL(static_cast<int>(i), links[i]);
+    }
+
+    // Every peer sends two frames.
+    std::vector<uint8_t> expected[3];
+
+    for (size_t i = 0; i < 3; i++) {
+        for (uint16_t j = 0; j < 2; j++) {
+            const std::vector<uint8_t> encoded = encodeReference(static_cast<uint16_t>(i * 2 + j), randomPayload(50, i + j, 4));
+
+            TEST_ASSERT_EQUAL(static_cast<ssize_t>(encoded.size()), write(peers[i], encoded.data(), encoded.size()));
+        }
+    }
+
+    for (size_t attempt = 0; attempt < 100 && frames.size() < 6; attempt++) {
+        TEST_ASSERT_TRUE(gateway.poll(100) >= 0);
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(6, frames.size());
+
+    for (const GatewayFrame& frame : frames) {
+        TEST_ASSERT_FALSE(frame.closed);
+        TEST_ASSERT_EQUAL_UINT32(frame.link, frame.flags / 2);
+        TEST_ASSERT_EQUAL_UINT32(50, frame.payload.size());
+    }
+
+    // Frames written by the gateway arrive at the peer.
+    const std::vector<uint8_t> payload = randomPayload(100, 9, 4);
+    const std::vector<uint8_t> encoded = encodeReference(0x0042, payload);
+
+    TEST_ASSERT_TRUE(gateway.write(links[1], 0x0042, payload.data(), static_cast<uint16_t>(payload.size())));
+    TEST_ASSERT_EQUAL_UINT32(0, gateway.getPending(links[1]));
+
+    std::vector<uint8_t> received(encoded.size());
+
+    TEST_ASSERT_EQUAL(static_cast<ssize_t>(encoded.size()), read(peers[1], received.data(), received.size()));
+    TEST_ASSERT_EQUAL_MEMORY(encoded.data(), received.data(), encoded.size());
+
+    // Closing a peer is reported once.
+    frames.clear();
+    close(peers[2]);
+
+    for (size_t attempt = 0; attempt < 100 && frames.empty(); attempt++) {
+        TEST_ASSERT_TRUE(gateway.poll(100) >= 0);
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(1, frames.size());
+    TEST_ASSERT_TRUE(frames[0].closed);
+    TEST_ASSERT_EQUAL_UINT32(2, frames[0].link);
+    TEST_ASSERT_FALSE(gateway.isOpen(links[2]));
+    TEST_ASSERT_FALSE(gateway.write(links[2], 0x0001, payload.data(), 1));
+
+    for (size_t i = 0; i < 3; i++) {
+        gateway.remove(links[i]);
+        close(sockets[i]);
+
+        if (i != 2) {
+            close(peers[i]);
+        }
+    }
+}
+void test_gateway_survives_closed_peer(void) {
+    std::vector<GatewayFrame> frames;
+    TinyLinkGateway gateway(2, 256, collectGatewayFrame, &frames);
+
+    int sockets[2];
+    int peers[2];
+
+    for (size_t i = 0; i < 2; i++) {
+        int fds[2];
+
+        TEST_ASSERT_EQUAL(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+        TEST_ASSERT_EQUAL(static_cast<int>(i), gateway.add(fds[0]));
+
+        sockets[i] = fds[0];
+        peers[i] = fds[1];
+    }
+
+    // Writing to a link whose peer is gone closes the link, instead of
+    // raising SIGPIPE.
+    const std::vector<uint8_t> payload = randomPayload(40, 1, 4);
+
+    close(peers[0]);
+
+    TEST_ASSERT_FALSE(gateway.write(0, 0x0001, payload.data(), static_cast<uint16_t>(payload.size())));
+    TEST_ASSERT_FALSE(gateway.isOpen(0));
+    TEST_ASSERT_EQUAL_UINT32(1, frames.size());
+    TEST_ASSERT_TRUE(frames[0].closed);
+    TEST_ASSERT_EQUAL_UINT32(0, frames[0].link);
+
+    // The close is not reported again, and the other link still works.
+    TEST_ASSERT_TRUE(gateway.write(1, 0x0002, payload.data(), static_cast<uint16_t>(payload.size())));
+    TEST_ASSERT_TRUE(gateway.poll(10) >= 0);
+    TEST_ASSERT_EQUAL_UINT32(1, frames.size());
+
+    const std::vector<uint8_t> encoded = encodeReference(0x0002, payload);
+    std::vector<uint8_t> received(encoded.size());
+
+    TEST_ASSERT_EQUAL(static_cast<ssize_t>(encoded.size()), read(peers[1], received.data(), received.size()));
+    TEST_ASSERT_EQUAL_MEMORY(encoded.data(), received.data(), encoded.size());
+
+    for (size_t i = 0; i < 2; i++) {
+        gateway.remove(i);
+        close(sockets[i]);
+    }
+
+    close(peers[1]);
+}
+
+void test_sharded_gateway_over_socketpairs(void) {
+    TinyLinkShardedGateway gateway(2, 4, 256, 64);
+
+    int sockets[4];
+    int peers[4];
+    int links[4];
+
+    for (size_t i = 0; i < 4; i++) {
+        int fds[2];
+
+        TEST_ASSERT_EQUAL(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+
+        links[i] = gateway.add(fds[0]);
+        sockets[i] = fds[0];
+        peers[i] = fds[1];
+
+        TEST_ASSERT_TRUE(links[i] >= 0);
+    }
+
+    // Links are spread across both threads.
+    TEST_ASSERT_EQUAL(0, links[0]);
+    TEST_ASSERT_EQUAL(4, links[1]);
+    TEST_ASSERT_TRUE(gateway.start());
+    TEST_ASSERT_EQUAL(-1, gateway.add(sockets[0]));
+
+    // Every peer sends ten frames, with the index of the peer as flags.
+    for (size_t i = 0; i < 4; i++) {
+        for (size_t j = 0; j < 10; j++) {
+            const std::vector<uint8_t> encoded = encodeReference(static_cast<uint16_t>(i), randomPayload(40, i * 10 + j, 4));
+
+            TEST_ASSERT_EQUAL(static_cast<ssize_t>(encoded.size()), write(peers[i], encoded.data(), encoded.size()));
+        }
+    }
+
+    size_t counts[4] = {0, 0, 0, 0};
+    size_t received = 0;
+
+    for (size_t attempt = 0; attempt < 100000 && received < 40; attempt++) {
+        size_t link;
+        frame_t frame;
+
+        if (!gateway.read(&link, &frame)) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        size_t peer = static_cast<size_t>(frame.flags);
+
+        TEST_ASSERT_EQUAL(links[peer], static_cast<int>(link));
+
+        const std::vector<uint8_t> expected = randomPayload(40, peer * 10 + counts[peer], 4);
+
+        TEST_ASSERT_EQUAL_UINT16(40, frame.length);
+        TEST_ASSERT_EQUAL_MEMORY(expected.data(), frame.payload, 40);
+
+        counts[peer]++;
+        received++;
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(40, received);
+    TEST_ASSERT_EQUAL_UINT32(0, gateway.getDrops());
+
+    // Frames written to a link are written by its worker thread.
+    TEST_ASSERT_FALSE(gateway.write(8, 0x0001, NULL, 0));
+
+    for (size_t i = 0; i < 4; i++) {
+        const std::vector<uint8_t> payload = randomPayload(40, 100 + i, 4);
+
+        TEST_ASSERT_TRUE(gateway.write(static_cast<size_t>(links[i]), static_cast<uint16_t>(i), payload.data(), 40));
+    }
+
+    for (size_t i = 0; i < 4; i++) {
+        const std::vector<uint8_t> expected = encodeReference(static_cast<uint16_t>(i), randomPayload(40, 100 + i, 4));
+        std::vector<uint8_t> actual(expected.size());
+        size_t length = 0;
+
+        while (length < actual.size()) {
+            ssize_t result = read(peers[i], &actual[length], actual.size() - length);
+
+            TEST_ASSERT_TRUE(result > 0);
+
+            length += static_cast<size_t>(result);
+        }
+
+        TEST_ASSERT_EQUAL_MEMORY(expected.data(), actual.data(), expected.size());
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(0, gateway.getWriteDrops());
+
+    // Closing a peer is reported as a frame without payload.
+    close(peers[3]);
+
+    size_t link = 0;
+    frame_t frame;
+    bool closed = false;
+
+    for (size_t attempt = 0; attempt < 100000 && !closed; attempt++) {
+        if (gateway.read(&link, &frame)) {
+            closed = frame.payload == NULL;
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+
+    TEST_ASSERT_TRUE(closed);
+    TEST_ASSERT_EQUAL(links[3], static_cast<int>(link));
+
+    gateway.stop();
+
+    for (size_t i = 0; i < 4; i++) {
+        close(sockets[i]);
+
+        if (i != 3) {
+            close(peers[i]);
+        }
+    }
+}
+void test_sharded_gateway_survives_closed_peer(void) {
+    TinyLinkShardedGateway gateway(2, 2, 256, 16);
+
+    int sockets[4];
+    int peers[4];
+    int links[4];
+
+    for (size_t i = 0; i < 4; i++) {
+        int fds[2];
+
+        TEST_ASSERT_EQUAL(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+
+        links[i] = gateway.add(fds[0]);
+        sockets[i] = fds[0];
+        peers[i] = fds[1];
+
+        TEST_ASSERT_TRUE(links[i] >= 0);
+    }
+
+    TEST_ASSERT_TRUE(gateway.start());
+
+    // The worker thread writing to a link whose peer is gone closes only that
+    // link, instead of raising SIGPIPE.
+    const std::vector<uint8_t> payload = randomPayload(40, 1, 4);
+
+    close(peers[0]);
+
+    TEST_ASSERT_TRUE(gateway.write(static_cast<size_t>(links[0]), 0x0001, payload.data(), 40));
+
+    size_t link = 0;
+    frame_t frame;
+    bool closed = false;
+
+    for (size_t attempt = 0; attempt < 100000 && !closed; attempt++) {
+        if (gateway.read(&link, &frame)) {
+            closed = frame.payload == NULL;
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+
+    TEST_ASSERT_TRUE(closed);
+    TEST_ASSERT_EQUAL(links[0], static_cast<int>(link));
+
+    // The other links, on both worker threads, still work.
+    for (size_t i = 1; i < 4; i++) {
+        TEST_ASSERT_TRUE(gateway.write(static_cast<size_t>(links[i]), static_cast<uint16_t>(i), payload.data(), 40));
+    }
+
+    for (size_t i = 1; i < 4; i++) {
+        const std::vector<uint8_t> expected = encodeReference(static_cast<uint16_t>(i), payload);
+        std::vector<uint8_t> actual(expected.size());
+        size_t length = 0;
+
+        while (length < actual.size()) {
+            ssize_t result = read(peers[i], &actual[length], actual.size() - length);
+
+            TEST_ASSERT_TRUE(result > 0);
+
+            length += static_cast<size_t>(result);
+        }
+
+        TEST_ASSERT_EQUAL_MEMORY(expected.data(), actual.data(), expected.size());
+    }
+
+    gateway.stop();
+
+    for (size_t i = 0; i < 4; i++) {
+        close(sockets[i]);
+
+        if (i != 0) {
+            close(peers[i]);
+        }
+    }
+}
+
+void test_sharded_gateway_waits_for_room(void) {
+    // Three slots are rounded up to four.
+    TinyLinkShardedGateway gateway(1, 1, 256, 3);
+
+    int fds[2];
+
+    TEST_ASSERT_EQUAL(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    TEST_ASSERT_EQUAL(0, gateway.add(fds[0]));
+    TEST_ASSERT_TRUE(gateway.start());
+
+    // The peer sends many more frames than fit in the queue, and closes the
+    // link before anything is read.
+    for (size_t i = 0; i < 20; i++) {
+        const std::vector<uint8_t> encoded = encodeReference(static_cast<uint16_t>(i), randomPayload(40, i, 4));
+
+        TEST_ASSERT_EQUAL(static_cast<ssize_t>(encoded.size()), write(fds[1], encoded.data(), encoded.size()));
+    }
+
+    close(fds[1]);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    // Nothing is dropped, and the close is reported after the last frame.
+    size_t received = 0;
+    bool closed = false;
+
+    for (size_t attempt = 0; attempt < 100000 && !closed; attempt++) {
+        size_t link;
+        frame_t frame;
+
+        if (!gateway.read(&link, &frame)) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        TEST_ASSERT_EQUAL(0, static_cast<int>(link));
+
+        if (frame.payload == NULL) {
+            closed = true;
+            continue;
+        }
+
+        const std::vector<uint8_t> expected = randomPayload(40, received, 4);
+
+        TEST_ASSERT_EQUAL_UINT16(received, frame.flags);
+        TEST_ASSERT_EQUAL_MEMORY(expected.data(), frame.payload, 40);
+
+        received++;
+    }
+
+    TEST_ASSERT_TRUE(closed);
+    TEST_ASSERT_EQUAL_UINT32(20, received);
+    TEST_ASSERT_EQUAL_UINT32(0, gateway.getDrops());
+
+    gateway.stop();
+
+    close(fds[0]);
+}
+#endif
+
+#if TINYLINK_STATS
+void test_stats_count_frames_and_rejects(void) {
+    uint8_t buffer[64];
+    MockStream stream;
+    TinyLink tinylink(stream, buffer, sizeof(buffer));
+
+    // Writing counts the bytes added by escaping.
+    const uint8_t data[] = {0x10, 0xAA, 0x1B, 0x20};
+
+    TEST_ASSERT_TRUE(tinylink.write(0x0001, data, sizeof(data)));
+
+    tinylink_stats_t stats = tinylink.getStats();
+
+    TEST_ASSERT_EQUAL_UINT32(1, stats.framesOut);
+    TEST_ASSERT_EQUAL_UINT32(stream.written.size(), stats.bytesOut);
+    TEST_ASSERT_EQUAL_UINT32(stream.written.size() - (LEN_PREAMBLE + LEN_HEADER + sizeof(data) + LEN_CRC), stats.escapesOut);
+    TEST_ASSERT_TRUE(stats.escapesOut >= 2);
+
+    // With COBS, a code that takes the place of a FLAG adds nothing. Only the
+    // codes after a run of maximum length and of the last run add a byte.
+    uint8_t cobsBuffer[512];
+    MockStream cobsStream;
+    BasicTinyLink<TinyLinkCobsPolicy> cobs(cobsStream, cobsBuffer, sizeof(cobsBuffer));
+    std::vector<uint8_t> message(300, 0x42);
+
+    message[10] = FLAG;
+    message[20] = FLAG;
+
+    TEST_ASSERT_TRUE(cobs.write(0x0001, message.data(), message.size()));
+    TEST_ASSERT_EQUAL_UINT32(cobsStream.written.size() - (LEN_PREAMBLE + LEN_HEADER + message.size() + LEN_CRC), cobs.getStats().escapesOut);
+    TEST_ASSERT_TRUE(cobs.getStats().escapesOut >= 2);
+
+    // Noise, a valid frame, a frame with an invalid header, a frame that does
+    // not fit and a frame with an invalid CRC. The header of every frame does
+    // not need escaping, so the bytes after a rejected header are skipped.
+    const std::vector<uint8_t> payload{1, 2, 3, 4, 5, 6, 7, 8};
+
+    std::vector<uint8_t> valid = encodeReference(0x0001, payload);
+    std::vector<uint8_t> header = encodeReference(0x0001, payload);
+    std::vector<uint8_t> large = encodeReference(0x0001, std::vector<uint8_t>(100, 0x42));
+    std::vector<uint8_t> crc = encodeReference(0x0001, payload);
+
+    header[LEN_PREAMBLE + 4] ^= 0x01;
+    crc[LEN_PREAMBLE + LEN_HEADER] ^= 0x01;
+
+    std::vector<uint8_t> incoming{0x00, 0x01, 0x02};
+
+    for (const std::vector<uint8_t>* frame : {&valid, &header, &large, &crc}) {
+        incoming.insert(incoming.end(), frame->begin(), frame->end());
+    }
+
+    stream.feed(incoming);
+
+    frame_t frame;
+    size_t frames = 0;
+
+    while (stream.available() > 0) {
+        if (tinylink.pollFrame(&frame)) {
+            frames++;
+        }
+    }
+
+    stats = tinylink.getStats();
+
+    TEST_ASSERT_EQUAL(1, frames);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.framesIn);
+    TEST_ASSERT_EQUAL_UINT32(incoming.size(), stats.bytesIn);
+    TEST_ASSERT_EQUAL_UINT32(3 + (header.size() - LEN_PREAMBLE - LEN_HEADER) + (large.size() - LEN_PREAMBLE - LEN_HEADER), stats.huntSkipped);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.headerRejects);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.lengthRejects);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.crcFailures);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.resyncs);
+
+    tinylink.resetStats();
+
+    stats = tinylink.getStats();
+
+    TEST_ASSERT_EQUAL_UINT32(0, stats.framesOut);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.bytesIn);
+
+    // A frame hidden in a truncated frame is found by scanning again.
+    uint8_t resync[64];
+    TinyLinkDecoder decoder(buffer, sizeof(buffer));
+
+    decoder.setResyncBuffer(resync, sizeof(resync));
+
+    std::vector<uint8_t> truncated = encodeReference(0x0001, payload);
+
+    truncated.resize(truncated.size() - 6);
+    truncated.insert(truncated.end(), valid.begin(), valid.end());
+
+    std::vector<DecodedFrame> decoded;
+
+    decoder.feed(truncated.data(), truncated.size(), collectFrame, &decoded);
+
+    TEST_ASSERT_EQUAL(1, decoded.size());
+    TEST_ASSERT_EQUAL_UINT32(1, decoder.getStats().framesIn);
+    TEST_ASSERT_EQUAL_UINT32(1, decoder.getStats().crcFailures);
+    TEST_ASSERT_EQUAL_UINT32(1, decoder.getStats().resyncs);
+
+    // Resetting in the middle of a preamble does not make the count wrap. The
+    // last byte of noise is counted once the preamble is complete.
+    TinyLinkDecoder split(buffer, sizeof(buffer));
+
+    incoming = {0x00, 0x01, 0x02};
+    incoming.insert(incoming.end(), valid.begin(), valid.end());
+
+    decoded.clear();
+    split.feed(incoming.data(), 5, collectFrame, &decoded);
+
+    TEST_ASSERT_EQUAL_UINT32(2, split.getStats().huntSkipped);
+
+    split.resetStats();
+    split.feed(&incoming[5], incoming.size() - 5, collectFrame, &decoded);
+
+    TEST_ASSERT_EQUAL(1, decoded.size());
+    TEST_ASSERT_EQUAL_UINT32(1, split.getStats().huntSkipped);
+}
+#endif
+
+#if TINYLINK_TRACE
+static void collectTraceEvent(tinylink_trace_e event, void* context) {
+    static_cast<std::vector<tinylink_trace_e>*>(context)->push_back(event);
+}
+
+void test_trace_callback_brackets_frames(void) {
+    uint8_t buffer[64];
+    MockStream stream;
+    TinyLink tinylink(stream, buffer, sizeof(buffer));
+
+    std::vector<tinylink_trace_e> events;
+
+    tinylink.setTraceCallback(collectTraceEvent, &events);
+
+    const uint8_t data[] = {1, 2, 3};
+
+    TEST_ASSERT_TRUE(tinylink.write(0x0001, data, sizeof(data)));
+
+    stream.feed(stream.written);
+
+    frame_t frame;
+
+    TEST_ASSERT_TRUE(tinylink.pollFrame(&frame));
+
+    const std::vector<tinylink_trace_e> expected{TRACE_ENCODE_BEGIN, TRACE_ENCODE_END, TRACE_DECODE_BEGIN, TRACE_DECODE_END};
+
+    TEST_ASSERT_TRUE(events == expected);
+
+    // A frame with an invalid header ends when it is rejected, and a partial
+    // frame ends when the next byte arrives after the timeout.
+    const std::vector<tinylink_trace_e> rejected{TRACE_DECODE_BEGIN, TRACE_DECODE_END};
+
+    std::vector<uint8_t> header = encodeReference(0x0001, std::vector<uint8_t>(data, data + sizeof(data)));
+
+    header[LEN_PREAMBLE + 4] ^= 0x01;
+
+    events.clear();
+    stream.feed(header);
+
+    while (stream.available() > 0) {
+        TEST_ASSERT_FALSE(tinylink.pollFrame(&frame));
+    }
+
+    TEST_ASSERT_TRUE(events == rejected);
+
+    std::vector<uint8_t> partial = encodeReference(0x0001, std::vector<uint8_t>(data, data + sizeof(data)));
+
+    partial.resize(LEN_PREAMBLE + 2);
+
+    fakeTime = 0;
+    tinylink.setTimeout(fakeClock, 10, 0);
+
+    events.clear();
+    stream.feed(partial);
+
+    while (stream.available() > 0) {
+        TEST_ASSERT_FALSE(tinylink.pollFrame(&frame));
+    }
+
+    fakeTime = 20;
+    stream.feed({0x00});
+
+    TEST_ASSERT_FALSE(tinylink.pollFrame(&frame));
+    TEST_ASSERT_TRUE(events == rejected);
+}
+#endif
+
+#ifdef TINYLINK_HAS_CAPTURE
+static bool sameCaptureFrames(const std::vector<capture_frame_t>& a, const std::vector<capture_frame_t>& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].offset != b[i].offset || a[i].flags != b[i].flags || a[i].length != b[i].length || a[i].valid != b[i].valid) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void test_capture_parallel_decode_matches_sequential(void) {
+    // A capture with valid, corrupted, truncated and oversized frames, and
+    // noise in between. Truncated frames swallow the frame that follows.
+    std::vector<uint8_t> data;
+    uint32_t seed = 7;
+
+    for (size_t i = 0; i < 600; i++) {
+        seed = seed * 1103515245 + 12345;
+
+        const uint16_t length = static_cast<uint16_t>((seed >> 8) % (i % 10 == 0 ? 400 : 100));
+        std::vector<uint8_t> encoded = encodeReference(static_cast<uint16_t>(i), randomPayload(length, seed, 8));
+
+        switch ((seed >> 20) % 8) {
+            case 0:
+                encoded[encoded.size() / 2 + 2] ^= 0x40;
+                break;
+            case 1:
+                encoded.resize(encoded.size() / 2 + 2);
+                break;
+            case 2:
+                for (size_t j = 0; j < (seed >> 4) % 32; j++) {
+                    data.push_back(static_cast<uint8_t>(seed >> j));
+                }
+                break;
+        }
+
+        data.insert(data.end(), encoded.begin(), encoded.end());
+    }
+
+    const uint16_t maxLength = 300;
+
+    std::vector<capture_frame_t> sequential;
+
+    TinyLinkCapture::decode(data.data(), data.size(), 1, 1, maxLength, &sequential);
+
+    // The sequential decode reports the same frames as the decoder of a link.
+    std::vector<uint8_t> buffer(LEN_HEADER + maxLength + LEN_BODY + 1);
+    TinyLinkDecoder decoder(buffer.data(), buffer.size());
+    std::vector<DecodedFrame> decoded;
+
+    decoder.feed(data.data(), data.size(), collectFrame, &decoded);
+
+    std::vector<capture_frame_t> valid;
+
+    for (const capture_frame_t& frame : sequential) {
+        if (frame.valid) {
+            valid.push_back(frame);
+        }
+    }
+
+    TEST_ASSERT_TRUE(valid.size() < sequential.size());
+    TEST_ASSERT_EQUAL(decoded.size(), valid.size());
+
+    for (size_t i = 0; i < valid.size(); i++) {
+        TEST_ASSERT_EQUAL_HEX16(decoded[i].flags, valid[i].flags);
+        TEST_ASSERT_EQUAL(decoded[i].payload.size(), valid[i].length);
+    }
+
+    // Any split into chunks gives the same result.
+    const size_t chunks[] = {2, 3, 7, 16, 61, 250, 2000};
+
+    for (size_t threads = 1; threads <= 4; threads += 3) {
+        for (size_t count : chunks) {
+            std::vector<capture_frame_t> parallel;
+
+            TinyLinkCapture::decode(data.data(), data.size(), threads, count, maxLength, &parallel);
+
+            TEST_ASSERT_TRUE(sameCaptureFrames(sequential, parallel));
+        }
+    }
+
+    // Decoding a file does not limit the length of frames.
+    char path[] = "/tmp/tinylink-capture-XXXXXX";
+    int fd = mkstemp(path);
+
+    TEST_ASSERT_TRUE(fd >= 0);
+    TEST_ASSERT_EQUAL(data.size(), write(fd, data.data(), data.size()));
+    close(fd);
+
+    std::vector<capture_frame_t> unlimited;
+    std::vector<capture_frame_t> mapped;
+
+    TinyLinkCapture::decode(data.data(), data.size(), 1, 1, 0xFFFF, &unlimited);
+
+    TEST_ASSERT_TRUE(TinyLinkCapture::decodeFile(path, 4, &mapped));
+    TEST_ASSERT_TRUE(sameCaptureFrames(unlimited, mapped));
+
+    unlink(path);
+}
+#endif
+
+void test_crc32_known_value(void) {
+    const uint8_t data[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+
+    // The standard CRC32 check value, with pre- and post-inversion applied.
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926, ~CRC32(0xFFFFFFFF, data, sizeof(data)));
+}
+
+void test_crc32_matches_bitwise_reference(void) {
+    uint8_t data[300];
+    uint32_t seed = 0x12345678;
+
+    for (size_t i = 0; i < sizeof(data); i++) {
+        seed = seed * 1103515245 + 12345;
+        data[i] = static_cast<uint8_t>(seed >> 16);
+    }
+
+    // Cover all lengths, unaligned offsets and non-zero initial values.
+    for (size_t offset = 0; offset < 8; offset++) {
+        for (size_t length = 0; length <= sizeof(data) - offset; length++) {
+            const uint32_t initial = static_cast<uint32_t>(offset * 0x01010101);
+
+            TEST_ASSERT_EQUAL_HEX32(
+                CRC32Bitwise(initial, &data[offset], length),
+                CRC32(initial, &data[offset], length));
+        }
+    }
+
+    // Computing in parts must yield the same as computing at once.
+    TEST_ASSERT_EQUAL_HEX32(CRC32(data, sizeof(data)), CRC32(CRC32(data, 13), &data[13], sizeof(data) - 13));
+    TEST_ASSERT_EQUAL_HEX32(CRC32(data, 1), CRC32(data[0]));
+    TEST_ASSERT_EQUAL_HEX32(CRC32(data, 2), CRC32(CRC32(data[0]), data[1]));
+}
+
 int main() {
     UNITY_BEGIN();
 
@@ -335,6 +2762,65 @@ int main() {
     RUN_TEST(test_convenience_write);
     RUN_TEST(test_convenience_read);
     RUN_TEST(test_convenience_read_rejects_too_large);
+    RUN_TEST(test_write_frame_matches_reference);
+    RUN_TEST(test_write_frame_batches_writes);
+    RUN_TEST(test_read_frame_round_trip);
+    RUN_TEST(test_read_frame_rejects_invalid_crc);
+    RUN_TEST(test_read_frame_ignores_empty_stream);
+    RUN_TEST(test_poll_frame_reads_all_available);
+    RUN_TEST(test_poll_frame_leftover_used_by_read_frame);
+    RUN_TEST(test_decoder_feed_reports_all_frames);
+    RUN_TEST(test_decoder_feed_stops_after_frame);
+    RUN_TEST(test_encoder_matches_reference);
+    RUN_TEST(test_encoder_rejects_small_buffer);
+    RUN_TEST(test_encoder_encodes_batch);
+    RUN_TEST(test_write_frame_segments);
+    RUN_TEST(test_write_frame_streaming);
+    RUN_TEST(test_write_frame_streaming_incomplete);
+    RUN_TEST(test_decoder_chunks);
+    RUN_TEST(test_decoder_chunks_small_buffer);
+    RUN_TEST(test_decoder_destination);
+    RUN_TEST(test_decoder_destination_callback);
+    RUN_TEST(test_pool_keeps_frames_until_released);
+    RUN_TEST(test_ring_push_and_read);
+    RUN_TEST(test_ring_concurrent);
+    RUN_TEST(test_ring_drained_into_decoder);
+    RUN_TEST(test_queue_pumps_without_blocking);
+    RUN_TEST(test_queue_counts_drops);
+    RUN_TEST(test_queue_fills_up_exactly);
+    RUN_TEST(test_scheduler_interleaves_at_frame_boundaries);
+    RUN_TEST(test_aggregator_packs_messages);
+    RUN_TEST(test_aggregator_flushes_after_timeout);
+    RUN_TEST(test_aggregator_keeps_messages_when_writing_fails);
+    RUN_TEST(test_aggregator_cobs_policy);
+    RUN_TEST(test_unpacker_stops_at_malformed_message);
+    RUN_TEST(test_cobs_policy_round_trip);
+    RUN_TEST(test_cobs_policy_resynchronizes);
+    RUN_TEST(test_decoder_hunts_preamble_in_noise);
+    RUN_TEST(test_decoder_resync_recovers_hidden_frames);
+    RUN_TEST(test_link_drains_recovered_frames);
+    RUN_TEST(test_decoder_push_scans_full_resync_buffer);
+    RUN_TEST(test_decoder_resync_recovers_frame_after_dropped_byte);
+    RUN_TEST(test_decoder_resync_never_loses_frames);
+    RUN_TEST(test_decoder_timeout_aborts_stale_frames);
+#ifdef TINYLINK_HAS_GATEWAY
+    RUN_TEST(test_gateway_over_socketpairs);
+    RUN_TEST(test_gateway_survives_closed_peer);
+    RUN_TEST(test_sharded_gateway_over_socketpairs);
+    RUN_TEST(test_sharded_gateway_survives_closed_peer);
+    RUN_TEST(test_sharded_gateway_waits_for_room);
+#endif
+#if TINYLINK_STATS
+    RUN_TEST(test_stats_count_frames_and_rejects);
+#endif
+#if TINYLINK_TRACE
+    RUN_TEST(test_trace_callback_brackets_frames);
+#endif
+#ifdef TINYLINK_HAS_CAPTURE
+    RUN_TEST(test_capture_parallel_decode_matches_sequential);
+#endif
+    RUN_TEST(test_crc32_known_value);
+    RUN_TEST(test_crc32_matches_bitwise_reference);
 
     return UNITY_END();
 }
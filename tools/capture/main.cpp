@@ -0,0 +1,34 @@
+#include <TinyLinkCapture.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Print the index of the frames in a capture file, one frame per line,
+ * as offset, flags, length and whether the CRC is valid.
+ *
+ * Usage: capture <file> [threads]
+ */
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <file> [threads]\n", argv[0]);
+        return 1;
+    }
+
+    size_t threads = argc > 2 ? strtoul(argv[2], NULL, 10) : std::thread::hardware_concurrency();
+    std::vector<capture_frame_t> frames;
+
+    if (!TinyLinkCapture::decodeFile(argv[1], threads, &frames)) {
+        fprintf(stderr, "Unable to read %s\n", argv[1]);
+        return 1;
+    }
+
+    for (const capture_frame_t& frame : frames) {
+        printf("%llu,0x%04x,%u,%s\n",
+            static_cast<unsigned long long>(frame.offset), frame.flags, frame.length, frame.valid ? "ok" : "crc");
+    }
+
+    return 0;
+}